@@ -0,0 +1,497 @@
+/*
+ * Benchmark Harness and Corpus Generators
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_BENCH_H
+#define PERUSE_BENCH_H  1
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-perf.h>
+
+static inline double bench_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Every case runs in a child process, thus every case starts with the
+ * same seed and corpora are the same from run to run
+ */
+static unsigned long bench_seed = 1;
+
+static inline size_t bench_rnd (size_t limit)
+{
+	bench_seed = bench_seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (bench_seed >> 33) % limit;
+}
+
+static inline void bench_fill (char *p, size_t len, const char *set)
+{
+	const size_t n = strlen (set);
+
+	for (; len > 0; --len)
+		*p++ = set[bench_rnd (n)];
+}
+
+/*
+ * Benchmark case result: the amount of work done and the time spent
+ */
+struct bench {
+	size_t bytes, tokens;
+	double time;
+};
+
+typedef int bench_fn (struct bench *o, const void *arg);
+
+/*
+ * Appends record to the file named by PERUSE_BENCH_LOG environment
+ * variable, if any: tab-separated values with the header line on the
+ * top of the file
+ */
+static inline void
+bench_log (const char *name, const char *test, const struct bench *o,
+	   long rss)
+{
+	const char *path = getenv ("PERUSE_BENCH_LOG");
+	FILE *f;
+
+	if (path == NULL || (f = fopen (path, "a")) == NULL)
+		return;
+
+	if (fseek (f, 0, SEEK_END) == 0 && ftell (f) == 0)
+		fprintf (f, "bench\tcase\tbytes\ttokens\tseconds\tMB/s\t"
+			    "tokens/s\tns/byte\tpeak-KiB\n");
+
+	fprintf (f, "%s\t%s\t%zu\t%zu\t%.6f\t%.2f\t%.0f\t%.3f\t%ld\n",
+		 name, test, o->bytes, o->tokens, o->time,
+		 o->bytes / o->time * 1e-6, o->tokens / o->time,
+		 o->time * 1e9 / o->bytes, rss);
+	fclose (f);
+}
+
+/*
+ * Returns mask of regions named in PERUSE_BENCH_PERF environment variable,
+ * or all the regions if it is not set
+ */
+static inline unsigned bench_perf_regions (void)
+{
+	const char *list = getenv ("PERUSE_BENCH_PERF");
+	unsigned mask = 0;
+	int r;
+
+	if (list == NULL)
+		return ~0u;
+
+	for (r = 0; r < NFA_PERF_REGIONS; ++r)
+		if (strstr (list, nfa_perf_region_name (r)) != NULL)
+			mask |= 1u << r;
+
+	return mask;
+}
+
+/*
+ * Prints hardware counter totals of instrumented regions, if the library
+ * is built with PERUSE_PERF defined
+ */
+static inline void bench_perf (void)
+{
+	struct nfa_perf_count c;
+	int r, e;
+
+	for (r = 0; r < NFA_PERF_REGIONS; ++r) {
+		if (!nfa_perf_read (r, &c))
+			continue;
+
+		printf ("%-12s %-6s %12llu calls", "", nfa_perf_region_name (r),
+			(unsigned long long) c.calls);
+
+		for (e = 0; e < NFA_PERF_EVENTS; ++e)
+			if ((c.valid & (1u << e)) != 0)
+				printf (", %s %llu", nfa_perf_event_name (e),
+					(unsigned long long) c.value[e]);
+
+		if ((c.valid & 3) == 3 && c.value[NFA_PERF_CYCLES] > 0)
+			printf (", IPC %.2f",
+				(double) c.value[NFA_PERF_INSTRUCTIONS] /
+				c.value[NFA_PERF_CYCLES]);
+
+		printf ("\n");
+	}
+}
+
+/*
+ * Runs benchmark case in a child process to report peak RSS of the case
+ * only. Returns 1 on success, zero otherwise.
+ */
+static inline int
+bench_run (const char *name, const char *test, bench_fn *fn, const void *arg)
+{
+	struct bench o = { 0, 0, 0 };
+	struct rusage ru;
+	pid_t pid;
+	int status;
+
+	fflush (NULL);
+
+	if ((pid = fork ()) < 0)
+		return 0;
+
+	if (pid == 0) {
+		if (!nfa_perf_open (bench_perf_regions ()) && errno != ENOSYS)
+			fprintf (stderr, "%s: %s: perf counters unavailable\n",
+				 name, test);
+
+		if (!fn (&o, arg) || o.bytes == 0 || o.time <= 0)
+			_exit (1);
+
+		nfa_perf_close ();
+
+		getrusage (RUSAGE_SELF, &ru);
+
+		printf ("%-12s %-20s %9.1f MB/s %9.3f Mtok/s %7.2f ns/byte "
+			"%8ld KiB peak\n", name, test, o.bytes / o.time * 1e-6,
+			o.tokens / o.time * 1e-6, o.time * 1e9 / o.bytes,
+			ru.ru_maxrss);
+
+		bench_perf ();
+		bench_log (name, test, &o, ru.ru_maxrss);
+		fflush (NULL);
+		_exit (0);
+	}
+
+	if (waitpid (pid, &status, 0) != pid)
+		return 0;
+
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		fprintf (stderr, "%s: %s: cannot run benchmark\n", name, test);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Program-like text: identifiers, keywords, numbers, operators, string
+ * literals and comments (which contain token-like text), matched by
+ * rules of bench_code_rules
+ */
+static inline char *bench_code (size_t size)
+{
+	static const char *text = "abc xyz 0123 +-*/ # ";
+	static const char *keyword[] = {
+		"if", "else", "while", "for", "return", "int", "char",
+	};
+	char *data, *p, *end;
+	const char *w;
+	size_t len;
+
+	if ((data = malloc (size + 1)) == NULL)
+		return NULL;
+
+	for (p = data, end = data + size - 128; p < end; *p++ = '\n')
+		while (p < end && bench_rnd (12) != 0) {
+			switch (bench_rnd (8)) {
+			case 0:
+				w = keyword[bench_rnd (7)];
+				len = strlen (w);
+				memcpy (p, w, len);
+				break;
+			case 1:
+			case 2:
+				len = 1 + bench_rnd (12);
+				bench_fill (p, len, "abcdefghijklmnopqrstuvwxyz_");
+				break;
+			case 3:
+				len = 1 + bench_rnd (8);
+				bench_fill (p, len, "0123456789");
+				break;
+			case 4:
+			case 5:
+				len = 1;
+				bench_fill (p, len, "+-*/=;(){},<>");
+				break;
+			case 6:
+				len = 2 + bench_rnd (40);
+				bench_fill (p, len, text);
+				p[0] = p[len - 1] = '"';
+				break;
+			default:
+				len = 2 + bench_rnd (60);
+				bench_fill (p, len, text);
+				p[0] = '#';
+				p += len;
+				*p++ = '\n';
+				continue;
+			}
+
+			p += len;
+			*p++ = ' ';
+		}
+
+	memset (p, ' ', data + size - p);
+	data[size] = '\0';
+	return data;
+}
+
+static inline const struct nfa_rule *bench_code_rules (void)
+{
+	static struct nfa_rule rules[] = {
+		{ rules + 1,	"if|else|while|for|return",	1 },
+		{ rules + 2,	"int|char",			2 },
+		{ rules + 3,	"[a-z_][a-z0-9_]*",		3 },
+		{ rules + 4,	"[0-9]+",			4 },
+		{ rules + 5,	"[-+*/=;(){},<>]",		5 },
+		{ rules + 6,	"\"[ !#-~]*\"",			6 },
+		{ rules + 7,	"#[ -~]*",			7 },
+		{ NULL,		"[ \t\n]+",			8 },
+	};
+
+	return rules;
+}
+
+/*
+ * Tokens of the specified length, one per line: string literals, line
+ * comments and identifiers, matched by rules of bench_long_rules
+ */
+static inline char *bench_long (size_t size, size_t len)
+{
+	char *data;
+	size_t i, j;
+
+	if ((data = malloc (size + 1)) == NULL)
+		return NULL;
+
+	for (i = 0, j = 0; i + len + 1 <= size; i += len + 1, ++j) {
+		memset (data + i, 'a' + j % 26, len);
+
+		switch (j % 3) {
+		case 0:
+			data[i] = data[i + len - 1] = '"';
+			break;
+		case 1:
+			data[i] = '#';
+			break;
+		}
+
+		data[i + len] = '\n';
+	}
+
+	memset (data + i, '\n', size - i);
+	data[size] = '\0';
+	return data;
+}
+
+static inline const struct nfa_rule *bench_long_rules (void)
+{
+	static struct nfa_rule rules[] = {
+		{ rules + 1,	"\"[ !#-~]*\"",		1 },
+		{ rules + 2,	"#[ -~]*",		2 },
+		{ rules + 3,	"[a-z_][a-z0-9_]*",	3 },
+		{ NULL,		"[ \t\n]+",		4 },
+	};
+
+	return rules;
+}
+
+/*
+ * Lines of random a and b of the specified length: the worst case for
+ * alternation (a|b)*a(a|b)...(a|b) with k trailing groups as every line
+ * keeps up to 2^k DFA states (and k NFA states) alive. Every line is
+ * matched by the alternation as a whole.
+ */
+static inline char *bench_alt (size_t size, size_t len, size_t k)
+{
+	char *data;
+	size_t i;
+
+	if ((data = malloc (size + 1)) == NULL)
+		return NULL;
+
+	for (i = 0; i + len + 1 <= size; i += len + 1) {
+		bench_fill (data + i, len, "ab");
+		data[i + len - 1 - k] = 'a';
+		data[i + len] = '\n';
+	}
+
+	memset (data + i, '\n', size - i);
+	data[size] = '\0';
+	return data;
+}
+
+/*
+ * Returns the pathological alternation RE with k trailing groups
+ */
+static inline char *bench_alt_re (size_t k)
+{
+	char *re, *p;
+
+	if ((re = malloc (9 + k * 5 + 1)) == NULL)
+		return NULL;
+
+	p = re + sprintf (re, "(a|b)*a");
+
+	for (; k > 0; --k)
+		p += sprintf (p, "(a|b)");
+
+	return re;
+}
+
+#define BENCH_RE_SIZE	32
+
+/*
+ * Large rule set: unique keyword, identifier-like, number-like and
+ * optional-part rules. Texts are stored after the rules in the same
+ * allocation, thus the set is released with free.
+ */
+static inline struct nfa_rule *bench_rules (size_t count)
+{
+	static const char *format[] = {
+		"kw%zu", "[a-z]%zu[a-z0-9_]*", "(0x|0)%zu[0-9]+", "%zu(a|b)?c",
+	};
+	struct nfa_rule *o;
+	char *text;
+	size_t i;
+
+	if ((o = malloc (count * (sizeof (o[0]) + BENCH_RE_SIZE))) == NULL)
+		return NULL;
+
+	text = (char *) (o + count);
+
+	for (i = 0; i < count; ++i) {
+		o[i].next  = i + 1 < count ? o + i + 1 : NULL;
+		o[i].re    = text + i * BENCH_RE_SIZE;
+		o[i].color = 1 + i;
+
+		snprintf (o[i].re, BENCH_RE_SIZE, format[i % 4], i);
+	}
+
+	return o;
+}
+
+/*
+ * Words matched by the large rule set of the specified size, separated
+ * by spaces: the whitespace rule should be added after the set
+ */
+static inline char *bench_words (size_t size, size_t count)
+{
+	static const char *format[] = {
+		"kw%zu ", "x%zuy_1 ", "0x%zu42 ", "%zubc ",
+	};
+	char *data, *p, *end, word[BENCH_RE_SIZE];
+	size_t i, len;
+
+	if ((data = malloc (size + 1)) == NULL)
+		return NULL;
+
+	for (p = data, end = data + size; ; p += len) {
+		i = bench_rnd (count);
+		len = snprintf (word, sizeof (word), format[i % 4], i);
+
+		if (len > (size_t) (end - p))
+			break;
+
+		memcpy (p, word, len);
+	}
+
+	memset (p, ' ', end - p);
+	data[size] = '\0';
+	return data;
+}
+
+/*
+ * Expression of the sample TDOP grammar of the specified maximum depth
+ */
+static inline char *bench_exp (char *p, int depth)
+{
+	static const char *var = "abcdefghijklmnopqrstuvwxyz";
+	static const char *op  = "+-*^,";
+
+	if (depth == 0 || bench_rnd (3) == 0) {
+		*p++ = var[bench_rnd (26)];
+		return p;
+	}
+
+	switch (bench_rnd (5)) {
+	case 0:
+		*p++ = '-';
+		return bench_exp (p, depth - 1);
+	case 1:
+		p = bench_exp (p, depth - 1);
+		*p++ = '!';
+		return p;
+	case 2:
+		*p++ = '(';
+		p = bench_exp (p, depth - 1);
+		*p++ = ')';
+		return p;
+	case 3:  /* parenthesized, grammars differ in operand priorities */
+		*p++ = '(';
+		p = bench_exp (p, depth - 1);
+		*p++ = ' ', *p++ = '?', *p++ = ' ', *p++ = '(';
+		p = bench_exp (p, depth - 1);
+		*p++ = ')', *p++ = ' ', *p++ = ':', *p++ = ' ';
+		p = bench_exp (p, depth - 1);
+		*p++ = ')';
+		return p;
+	default:
+		p = bench_exp (p, depth - 1);
+		*p++ = ' ', *p++ = op[bench_rnd (5)], *p++ = ' ';
+		return bench_exp (p, depth - 1);
+	}
+}
+
+#define BENCH_EXP_DEPTH	6
+#define BENCH_EXP_MAX	8192	/* 3^(depth + 2) plus statement */
+
+/*
+ * Programs of the sample TDOP grammar: sequences of the specified number
+ * of assignments, every program is terminated by NUL, thus corpus ends
+ * with an empty program
+ */
+static inline char *bench_eqn (size_t size, size_t count)
+{
+	char *data, *p, *end;
+	size_t i;
+
+	if ((data = malloc (size + 1)) == NULL)
+		return NULL;
+
+	for (p = data, end = data + size; ; *p++ = '\0') {
+		if ((size_t) (end - p) < (count + 1) * BENCH_EXP_MAX)
+			break;
+
+		for (i = 0; i < count; ++i) {
+			*p++ = '\t';
+			*p++ = "wxyz"[bench_rnd (4)];
+			*p++ = ' ', *p++ = '=', *p++ = ' ';
+			p = bench_exp (p, BENCH_EXP_DEPTH);
+
+			if (i + 1 < count)
+				*p++ = ';';
+
+			*p++ = '\n';
+		}
+	}
+
+	memset (p, '\0', end - p + 1);
+	return data;
+}
+
+#endif  /* PERUSE_BENCH_H */
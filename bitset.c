@@ -1,7 +1,7 @@
 /*
  * Compact Binary Set
  *
- * Copyright (c) 2007-2020 Alexei A. Smekalkine <ikle@ikle.ru>
+ * Copyright (c) 2007-2024 Alexei A. Smekalkine <ikle@ikle.ru>
  *
  * SPDX-License-Identifier: BSD-2-Clause
  */
@@ -12,11 +12,215 @@
 
 #include <peruse/bitset.h>
 
+#if defined (__GNUC__) && defined (__x86_64__)
+#define BITSET_SIMD  1
+#include <immintrin.h>
+#endif
+
+#define BITSET_WORD	(sizeof (long) * CHAR_BIT)
+
 static size_t bitset_get_size (size_t limit)
 {
-	const size_t size = sizeof (long) * CHAR_BIT;
+	return (limit + BITSET_WORD - 1) / BITSET_WORD;
+}
+
+/*
+ * Word kernels: SSE2 is always available on x86-64, AVX2 is selected at
+ * run time. Short sets do not worth vector setup, thus scalar code is
+ * used for them.
+ */
+#ifdef BITSET_SIMD
+
+__attribute__ ((target ("avx2")))
+static int avx2_is_empty (const long *o, size_t count)
+{
+	__m256i acc = _mm256_setzero_si256 ();
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+		acc = _mm256_or_si256 (acc, _mm256_loadu_si256 ((void *) (o + i)));
+
+	for (; i < count; ++i)
+		if (o[i] != 0)
+			return 0;
+
+	return _mm256_testz_si256 (acc, acc);
+}
+
+__attribute__ ((target ("avx2")))
+static void avx2_union (long *o, const long *a, size_t count)
+{
+	__m256i x, y;
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		x = _mm256_loadu_si256 ((void *) (o + i));
+		y = _mm256_loadu_si256 ((const void *) (a + i));
+		_mm256_storeu_si256 ((void *) (o + i), _mm256_or_si256 (x, y));
+	}
+
+	for (; i < count; ++i)
+		o[i] |= a[i];
+}
+
+__attribute__ ((target ("avx2")))
+static int avx2_equal (const long *a, const long *b, size_t count)
+{
+	__m256i x, y, acc = _mm256_setzero_si256 ();
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		x = _mm256_loadu_si256 ((const void *) (a + i));
+		y = _mm256_loadu_si256 ((const void *) (b + i));
+		acc = _mm256_or_si256 (acc, _mm256_xor_si256 (x, y));
+	}
+
+	for (; i < count; ++i)
+		if (a[i] != b[i])
+			return 0;
+
+	return _mm256_testz_si256 (acc, acc);
+}
+
+static int sse2_is_empty (const long *o, size_t count)
+{
+	__m128i acc = _mm_setzero_si128 ();
+	size_t i;
+
+	for (i = 0; i + 2 <= count; i += 2)
+		acc = _mm_or_si128 (acc, _mm_loadu_si128 ((const void *) (o + i)));
+
+	for (; i < count; ++i)
+		if (o[i] != 0)
+			return 0;
+
+	return _mm_movemask_epi8 (_mm_cmpeq_epi8 (acc, _mm_setzero_si128 ()))
+	       == 0xffff;
+}
+
+static void sse2_union (long *o, const long *a, size_t count)
+{
+	__m128i x, y;
+	size_t i;
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		x = _mm_loadu_si128 ((void *) (o + i));
+		y = _mm_loadu_si128 ((const void *) (a + i));
+		_mm_storeu_si128 ((void *) (o + i), _mm_or_si128 (x, y));
+	}
+
+	for (; i < count; ++i)
+		o[i] |= a[i];
+}
+
+static int sse2_equal (const long *a, const long *b, size_t count)
+{
+	__m128i x, y;
+	size_t i;
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		x = _mm_loadu_si128 ((const void *) (a + i));
+		y = _mm_loadu_si128 ((const void *) (b + i));
+
+		if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (x, y)) != 0xffff)
+			return 0;
+	}
+
+	for (; i < count; ++i)
+		if (a[i] != b[i])
+			return 0;
+
+	return 1;
+}
+
+static int has_avx2 (void)
+{
+	static int avx2 = -1;
+
+	if (avx2 < 0)
+		avx2 = __builtin_cpu_supports ("avx2");
+
+	return avx2;
+}
+
+#endif  /* BITSET_SIMD */
+
+#define BITSET_VECTOR	8  /* minimum number of words for vector code */
+
+static int words_is_empty (const long *o, size_t count)
+{
+	size_t i;
+
+#ifdef BITSET_SIMD
+	if (count >= BITSET_VECTOR)
+		return has_avx2 () ? avx2_is_empty (o, count) :
+				     sse2_is_empty (o, count);
+#endif
+	for (i = 0; i < count; ++i)
+		if (o[i] != 0)
+			return 0;
+
+	return 1;
+}
+
+static void words_union (long *o, const long *a, size_t count)
+{
+	size_t i;
+
+#ifdef BITSET_SIMD
+	if (count >= BITSET_VECTOR) {
+		if (has_avx2 ())
+			avx2_union (o, a, count);
+		else
+			sse2_union (o, a, count);
+
+		return;
+	}
+#endif
+	for (i = 0; i < count; ++i)
+		o[i] |= a[i];
+}
+
+static int words_equal (const long *a, const long *b, size_t count)
+{
+	size_t i;
+
+#ifdef BITSET_SIMD
+	if (count >= BITSET_VECTOR)
+		return has_avx2 () ? avx2_equal (a, b, count) :
+				     sse2_equal (a, b, count);
+#endif
+	for (i = 0; i < count; ++i)
+		if (a[i] != b[i])
+			return 0;
+
+	return 1;
+}
+
+static size_t word_ctz (unsigned long x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzl (x);
+#else
+	size_t n;
 
-	return (limit + size - 1) / size;
+	for (n = 0; (x & 1) == 0; x >>= 1, ++n) {}
+
+	return n;
+#endif
+}
+
+static size_t word_count (unsigned long x)
+{
+#ifdef __GNUC__
+	return __builtin_popcountl (x);
+#else
+	size_t n;
+
+	for (n = 0; x != 0; x &= x - 1, ++n) {}
+
+	return n;
+#endif
 }
 
 void bitset_clear (long *o, size_t limit)
@@ -42,7 +246,7 @@ void bitset_add (long *o, size_t x)
 	const size_t pos = x / size;
 	const size_t bit = x % size;
 
-	o[pos] |= (1L << bit);
+	o[pos] |= (1UL << bit);
 }
 
 int bitset_is_member (const long *o, size_t x)
@@ -51,27 +255,91 @@ int bitset_is_member (const long *o, size_t x)
 	const size_t pos = x / size;
 	const size_t bit = x % size;
 
-	return (o[pos] & (1L << bit)) != 0;
+	return (o[pos] & (1UL << bit)) != 0;
 }
 
 int bitset_is_empty (const long *o, size_t limit)
+{
+	return words_is_empty (o, bitset_get_size (limit));
+}
+
+size_t bitset_find (const long *o, size_t from, size_t limit)
+{
+	const size_t count = bitset_get_size (limit);
+	size_t pos = from / BITSET_WORD, x;
+	unsigned long w;
+
+	if (from >= limit)
+		return limit;
+
+	/* skip members before from, then skip whole zero words */
+	for (
+		w = (unsigned long) o[pos] & (~0UL << (from % BITSET_WORD));
+		w == 0;
+		w = o[pos]
+	)
+		if (++pos >= count)
+			return limit;
+
+	x = pos * BITSET_WORD + word_ctz (w);
+	return x < limit ? x : limit;
+}
+
+void bitset_union (long *o, const long *a, size_t limit)
+{
+	words_union (o, a, bitset_get_size (limit));
+}
+
+void bitset_and (long *o, const long *a, size_t limit)
 {
 	size_t i, count = bitset_get_size (limit);
 
 	for (i = 0; i < count; ++i)
-		if (o[i] != 0)
-			return 0;
+		o[i] &= a[i];
+}
 
-	return 1;
+int bitset_equal (const long *a, const long *b, size_t limit)
+{
+	return words_equal (a, b, bitset_get_size (limit));
 }
 
-size_t bitset_find (const long *o, size_t from, size_t limit)
+size_t bitset_hash (const long *o, size_t limit)
+{
+	size_t i, count = bitset_get_size (limit), hash = count;
+
+	for (i = 0; i < count; ++i) {
+		hash ^= (unsigned long) o[i];
+		hash *= (size_t) 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> (sizeof (hash) * CHAR_BIT / 2);
+	}
+
+	return hash;
+}
+
+size_t bitset_count (const long *o, size_t limit)
 {
-	size_t x;
+	size_t i, count = bitset_get_size (limit), n = 0;
 
-	for (x = from; x < limit; ++x)
-		if (bitset_is_member (o, x))
-			return x;
+	for (i = 0; i < count; ++i)
+		n += word_count (o[i]);
 
-	return limit;
+	return n;
+}
+
+int bitset_init (struct bitset *o, size_t limit)
+{
+	o->limit = limit;
+
+	if (limit <= BITSET_WORD) {
+		o->word = 0;
+		return 1;
+	}
+
+	return (o->data = bitset_alloc (limit)) != NULL;
+}
+
+void bitset_fini (struct bitset *o)
+{
+	if (o->limit > BITSET_WORD)
+		bitset_free (o->data);
 }
@@ -1,7 +1,7 @@
 /*
  * Compact Binary Set
  *
- * Copyright (c) 2007-2020 Alexei A. Smekalkine <ikle@ikle.ru>
+ * Copyright (c) 2007-2024 Alexei A. Smekalkine <ikle@ikle.ru>
  *
  * SPDX-License-Identifier: BSD-2-Clause
  */
@@ -9,6 +9,7 @@
 #ifndef PERUSE_BITSET_H
 #define PERUSE_BITSET_H  1
 
+#include <limits.h>
 #include <stddef.h>
 
 long *bitset_alloc (size_t limit);
@@ -20,6 +21,50 @@ void bitset_add (long *o, size_t x);
 int bitset_is_member (const long *o, size_t x);
 int bitset_is_empty  (const long *o, size_t limit);
 
+/*
+ * The function bitset_find returns the first member of set not less than
+ * from, or limit if there is no such member.
+ */
 size_t bitset_find (const long *o, size_t from, size_t limit);
 
+#define bitset_foreach(x, o, limit)				\
+	for (							\
+		(x) = bitset_find ((o), 0, (limit));		\
+		(x) < (limit);					\
+		(x) = bitset_find ((o), (x) + 1, (limit))	\
+	)
+
+/*
+ * The function bitset_union adds all members of set a to set o, the
+ * function bitset_and removes from set o all items that are not members
+ * of set a.
+ */
+void bitset_union (long *o, const long *a, size_t limit);
+void bitset_and   (long *o, const long *a, size_t limit);
+
+int    bitset_equal (const long *a, const long *b, size_t limit);
+size_t bitset_hash  (const long *o, size_t limit);
+size_t bitset_count (const long *o, size_t limit);
+
+/*
+ * Set with inline storage for small sets: sets with up to one machine
+ * word of items do not use heap.
+ */
+struct bitset {
+	size_t limit;
+
+	union {
+		long word;
+		long *data;
+	};
+};
+
+int  bitset_init (struct bitset *o, size_t limit);
+void bitset_fini (struct bitset *o);
+
+static inline long *bitset_data (struct bitset *o)
+{
+	return o->limit <= sizeof (long) * CHAR_BIT ? &o->word : o->data;
+}
+
 #endif  /* PERUSE_BITSET_H */
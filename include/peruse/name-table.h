@@ -18,6 +18,18 @@ void name_table_free (struct name_table *o);
 size_t name_table_max (struct name_table *o);
 size_t name_table_add (struct name_table *o, const char *name, size_t len);
 
+/*
+ * The function name_table_lookup returns identifier of the name, or zero
+ * if the name is not in the table. The function name_table_intern returns
+ * identifier of the name adding the name to the table if it is not there
+ * yet, returns zero on error.
+ *
+ * If len is zero then name is a null-terminated string. Name strings are
+ * copied into the table and live until the table is freed.
+ */
+size_t name_table_lookup (struct name_table *o, const char *name, size_t len);
+size_t name_table_intern (struct name_table *o, const char *name, size_t len);
+
 const char *name_table_get (struct name_table *o, size_t i);
 
 #endif  /* PERUSE_NAME_TABLE_H */
@@ -0,0 +1,70 @@
+/*
+ * Thompson NFA to DFA compiler
+ *
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_DFA_H
+#define PERUSE_NFA_DFA_H  1
+
+#include <peruse/nfa-state.h>
+
+/*
+ * The function nfa_dfa_alloc compiles NFA into complete minimal DFA over
+ * bytes. Every DFA state carries color of the rule matched on entry to
+ * this state, rules added earlier have a higher priority.
+ *
+ * NOTE: The DFA constructor captures NFA, no one should try to use the
+ * NFA passed to the constructor.
+ */
+struct nfa_dfa *nfa_dfa_alloc (struct nfa_state *nfa);
+void nfa_dfa_free (struct nfa_dfa *o);
+
+/*
+ * The function nfa_dfa_save writes DFA image into the file. Returns 1 on
+ * success, zero on error and sets errno.
+ *
+ * The function nfa_dfa_load maps DFA image saved into the file read-only
+ * and matches with the tables in place: no parsing, compilation or
+ * copying is performed, and processes which load the same file share the
+ * tables through the page cache. Returns NULL on error and sets errno.
+ *
+ * The image header and every transition are checked on load, thus
+ * a truncated, corrupt or foreign image is rejected with EINVAL. Image
+ * must come from a host with the same byte order.
+ */
+int nfa_dfa_save (const struct nfa_dfa *o, int fd);
+struct nfa_dfa *nfa_dfa_load (int fd);
+
+/*
+ * Get total number of states in DFA
+ */
+size_t nfa_dfa_count (const struct nfa_dfa *o);
+
+/*
+ * Get memory footprint of DFA tables (or mapped image) in bytes
+ */
+size_t nfa_dfa_size (const struct nfa_dfa *o);
+
+/*
+ * The function nfa_dfa_color returns color of the state, or -1 for the
+ * dead state. The function nfa_dfa_move returns the state reached from
+ * the state on the byte c. State 0 is the dead state, and state 1 is the
+ * start state.
+ */
+int nfa_dfa_color (const struct nfa_dfa *o, size_t state);
+size_t nfa_dfa_move (const struct nfa_dfa *o, size_t state, int c);
+
+/*
+ * returns node color on match (stop state reached), zero otherwise
+ */
+int nfa_dfa_start (struct nfa_dfa *o);
+
+/*
+ * returns -1 on error (no match), node color on match, zero otherwise
+ */
+int nfa_dfa_step (struct nfa_dfa *o, int c);
+
+#endif  /* PERUSE_NFA_DFA_H */
@@ -9,7 +9,13 @@
 #ifndef PERUSE_NFA_LEXER_H
 #define PERUSE_NFA_LEXER_H  1
 
+#include <stdio.h>
+
+#include <peruse/nfa-dfa.h>
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
 #include <peruse/nfa-state.h>
+#include <peruse/nfa-window.h>
 
 /*
  * The peruse_reader function reads upto count bytes into buffer.
@@ -22,14 +28,45 @@ typedef size_t peruse_reader (void *to, size_t count, void *cookie);
  * start state. If the reader is NULL then the standard I/O reader is used
  * and cookie should points to FILE object.
  *
- * If no maximum window size is specified, then the buffer size for
- * standard I/O is used.
+ * If no initial window size is specified, then the buffer size for
+ * standard I/O is used. The window grows to hold tokens of any length.
  *
  * NOTE: The NFA lexer constructor captures NFA, no one should try to use
  * the NFA passed to the constructor.
  */
 struct nfa_lexer *nfa_lexer_alloc (struct nfa_state *start, size_t size,
 				   peruse_reader *read, void *cookie);
+/*
+ * The function nfa_lexer_alloc_mmap creates NFA Lexer context which maps
+ * the whole file read-only and reads it without copying. Token text
+ * points directly into mapping, thus tokens stay valid for the lexer
+ * lifetime, and there is no limit on token length. The file should be
+ * a regular one, use nfa_lexer_alloc for pipes and terminals.
+ *
+ * NOTE: The mapped file lexer constructor captures NFA, no one should try
+ * to use the NFA passed to the constructor.
+ */
+struct nfa_lexer *nfa_lexer_alloc_mmap (struct nfa_state *start, int fd);
+/*
+ * The function nfa_lexer_alloc_dfa creates Lexer context which uses the
+ * specified compiled DFA instead of NFA simulation, other arguments are
+ * the same as for nfa_lexer_alloc.
+ *
+ * NOTE: The DFA lexer constructor captures DFA, no one should try to use
+ * the DFA passed to the constructor.
+ */
+struct nfa_lexer *nfa_lexer_alloc_dfa (struct nfa_dfa *dfa, size_t size,
+				       peruse_reader *read, void *cookie);
+/*
+ * The function nfa_lexer_alloc_rules creates Lexer context for the
+ * specified rules, other arguments are the same as for nfa_lexer_alloc.
+ * Plain literal rules (keywords, operators, dictionary words) are
+ * matched with trie, the other rules are matched with NFA. The longest
+ * match and rule priority are the same as for NFA of the rules.
+ */
+struct nfa_lexer *nfa_lexer_alloc_rules (const struct nfa_rule *rules,
+					 size_t size, peruse_reader *read,
+					 void *cookie);
 /*
  * The function nfa_lexer_free destroys NFA Lexer context.
  */
@@ -58,4 +95,68 @@ struct nfa_token {
 const struct nfa_token *nfa_lexer_get (struct nfa_lexer *o);
 const struct nfa_token *nfa_lexer     (struct nfa_lexer *o);
 
+/*
+ * The function nfa_lexer_batch stores up to max next matched tokens into
+ * the tokens array, as many as the current window holds, but at least
+ * one. Returns the number of tokens stored, or zero on EOF or error.
+ * Token texts stay valid until the next call to lexer.
+ */
+size_t nfa_lexer_batch (struct nfa_lexer *o, struct nfa_token *tokens,
+			size_t max);
+
+/*
+ * Lexer statistics. The array of token counts is indexed by color and
+ * stays valid until the next call to lexer. The footprint includes the
+ * lexer, window, processor and DFA.
+ */
+struct nfa_lexer_stats {
+	size_t bytes, tokens;		/* matched */
+	const size_t *color;		/* tokens per color */
+	size_t colors;			/* size of color array */
+	size_t restarts;		/* token scans continued after refill */
+	struct nfa_window_stats window;
+	struct nfa_proc_stats proc;	/* zero if NFA is not used */
+	size_t memory;			/* footprint, bytes */
+};
+
+/*
+ * The function nfa_lexer_stats stores statistics of the lexer. Returns
+ * 1 if the counters are maintained (the library is built with
+ * PERUSE_STATS defined), zero otherwise: the footprint is reported in
+ * any case.
+ */
+int nfa_lexer_stats (const struct nfa_lexer *o, struct nfa_lexer_stats *s);
+
+/*
+ * Rule profile: tokens matched and bytes consumed by the rule, steps with
+ * threads of the rule alive and the sum of their active NFA states (thus
+ * states / steps is the average number of active states), and bytes
+ * scanned past the end of the rule tokens looking for a longer match.
+ */
+struct nfa_rule_profile {
+	size_t tokens, bytes;
+	size_t steps, states;
+	size_t waste;
+};
+
+/*
+ * The function nfa_lexer_profile enables profiling of rules for the
+ * lexer, the profile starts empty. Returns 1 on success, or zero on
+ * error. Active states are counted for rules matched with NFA only.
+ *
+ * The function nfa_lexer_profile_get returns the array of rule profiles
+ * indexed by color and stores the size of the array into count, or
+ * returns NULL if profiling is not enabled. The array stays valid until
+ * the next call to lexer.
+ *
+ * The function nfa_lexer_report writes the table of rule profiles, the
+ * most expensive rules first.
+ */
+int nfa_lexer_profile (struct nfa_lexer *o);
+
+const struct nfa_rule_profile *
+nfa_lexer_profile_get (const struct nfa_lexer *o, size_t *count);
+
+void nfa_lexer_report (const struct nfa_lexer *o, FILE *to);
+
 #endif  /* PERUSE_NFA_LEXER_H */
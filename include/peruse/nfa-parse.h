@@ -1,7 +1,7 @@
 /*
  * Regular Expression to Thompson NFA compiler
  *
- * Copyright (c) 2020-2021 Alexei A. Smekalkine <ikle@ikle.ru>
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
  *
  * SPDX-License-Identifier: BSD-2-Clause
  */
@@ -11,8 +11,22 @@
 
 #include <peruse/nfa-state.h>
 
+/*
+ * The function nfa_parse_re compiles RE in UTF-8 into byte-level NFA:
+ * characters and ranges of characters match their UTF-8 sequences, and
+ * the dot matches any valid UTF-8 sequence. Ill-formed UTF-8 in RE is an
+ * error.
+ */
 struct nfa_state *nfa_parse_re (const char *re, int color);
 
+/*
+ * The function nfa_parse_literal checks if RE is a plain literal (a
+ * sequence of ordinary or escaped characters). Returns the length of
+ * the literal and stores its bytes into the text buffer (which should be
+ * as large as RE), or returns zero if RE is not a literal.
+ */
+size_t nfa_parse_literal (const char *re, char *text);
+
 struct nfa_rule {
 	struct nfa_rule *next;
 	char *re;
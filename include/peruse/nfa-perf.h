@@ -0,0 +1,70 @@
+/*
+ * Hardware Performance Counters for Matcher Hot Loops
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_PERF_H
+#define PERUSE_NFA_PERF_H  1
+
+#include <stdint.h>
+
+/*
+ * Instrumented regions: counts of a region include counts of regions
+ * called from it, thus lexer counts include processor step and window
+ * fill counts.
+ */
+enum nfa_perf_region {
+	NFA_PERF_STEP,		/* nfa_proc_step */
+	NFA_PERF_LEXER,		/* nfa_lexer */
+	NFA_PERF_FILL,		/* nfa_window_fill */
+	NFA_PERF_REGIONS,
+};
+
+enum nfa_perf_event {
+	NFA_PERF_CYCLES,
+	NFA_PERF_INSTRUCTIONS,
+	NFA_PERF_L1D_MISSES,
+	NFA_PERF_LLC_MISSES,
+	NFA_PERF_BRANCH_MISSES,
+	NFA_PERF_EVENTS,
+};
+
+struct nfa_perf_count {
+	uint64_t calls;
+	uint64_t value[NFA_PERF_EVENTS];
+	unsigned valid;		/* mask of events counted */
+};
+
+/*
+ * The instrumentation is compiled in if the library is built with
+ * PERUSE_PERF defined, otherwise nfa_perf_open fails with ENOSYS.
+ *
+ * The function nfa_perf_open opens user-space counters for the calling
+ * thread, resets totals and starts counting of the regions specified by
+ * the mask (bit 1 << region per region). Returns 1 on success, or zero
+ * on error (no PMU available, access denied). Events not supported by
+ * the hardware are left out of the valid mask. The function
+ * nfa_perf_close closes counters, totals stay readable.
+ *
+ * Every call of an instrumented function reads the counters twice, thus
+ * the counts include the cost of reading. This matters for per-byte
+ * nfa_proc_step: leave it out of the mask to measure the lexer as is.
+ */
+int  nfa_perf_open  (unsigned regions);
+void nfa_perf_close (void);
+void nfa_perf_reset (void);
+
+/*
+ * The function nfa_perf_read stores totals of the calling thread for
+ * the specified region. Returns 1 if the region was entered at least
+ * once, zero otherwise.
+ */
+int nfa_perf_read (enum nfa_perf_region region, struct nfa_perf_count *c);
+
+const char *nfa_perf_region_name (enum nfa_perf_region region);
+const char *nfa_perf_event_name  (enum nfa_perf_event event);
+
+#endif  /* PERUSE_NFA_PERF_H */
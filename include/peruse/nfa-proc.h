@@ -18,6 +18,24 @@
 struct nfa_proc *nfa_proc_alloc (struct nfa_state *nfa);
 void nfa_proc_free (struct nfa_proc *o);
 
+/*
+ * The function nfa_proc_clone creates a processor which shares NFA with
+ * the specified one, but has its own state and cache, thus the clones
+ * can be used from different threads. All clones should be freed before
+ * the original processor.
+ */
+struct nfa_proc *nfa_proc_clone (const struct nfa_proc *o);
+
+/*
+ * The processor caches sets of NFA states it sees as lazy DFA states.
+ * The function nfa_proc_set_cache sets the memory limit for this cache
+ * in bytes, zero disables the cache. The cache is flushed when the limit
+ * is reached, and if the cache is thrashing the processor falls back to
+ * plain NFA simulation. Without the cache automata of up to 64 states are
+ * simulated by bit-parallel engine, larger ones state by state.
+ */
+void nfa_proc_set_cache (struct nfa_proc *o, size_t limit);
+
 /*
  * returns node color on match (stop state reached), zero otherwise
  */
@@ -28,4 +46,40 @@ int nfa_proc_start (struct nfa_proc *o);
  */
 int nfa_proc_step (struct nfa_proc *o, int c);
 
+/*
+ * The function nfa_proc_search finds the leftmost longest match in data
+ * which starts at or after pos. Returns match color and stores match
+ * position into pos and match length into len, or returns zero if there
+ * is no match.
+ *
+ * Bytes which cannot start a match are skipped by the prefilter and are
+ * not fed to the automaton.
+ */
+int nfa_proc_search (struct nfa_proc *o, const void *data, size_t size,
+		     size_t *pos, size_t *len);
+
+/*
+ * Processor statistics. The histogram counts steps by the number of NFA
+ * states left active: bucket zero counts steps without match, bucket
+ * k > 0 counts steps with 2^(k-1) to 2^k - 1 states active, the last
+ * bucket counts larger sets too. The footprint includes the program for
+ * the original processor only, clones share it.
+ */
+#define NFA_PROC_ACTIVE	16
+
+struct nfa_proc_stats {
+	size_t bytes;			/* bytes processed */
+	size_t active[NFA_PROC_ACTIVE];	/* steps by active states count */
+	size_t states;			/* lazy DFA states cached */
+	size_t memory;			/* footprint, bytes */
+};
+
+/*
+ * The function nfa_proc_stats stores statistics of the processor.
+ * Returns 1 if the counters are maintained (the library is built with
+ * PERUSE_STATS defined), zero otherwise: the footprint and cache size
+ * are reported in any case.
+ */
+int nfa_proc_stats (const struct nfa_proc *o, struct nfa_proc_stats *s);
+
 #endif  /* PERUSE_NFA_PROC_H */
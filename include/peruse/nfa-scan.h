@@ -0,0 +1,52 @@
+/*
+ * Parallel Thompson NFA-based Lexer
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_SCAN_H
+#define PERUSE_NFA_SCAN_H  1
+
+#include <peruse/nfa-lexer.h>
+
+/*
+ * The function nfa_scan_alloc creates parallel lexer context which uses
+ * the specified number of threads. If no number of threads is specified,
+ * then the number of online processors is used.
+ *
+ * NOTE: The parallel lexer constructor captures NFA, no one should try to
+ * use the NFA passed to the constructor.
+ */
+struct nfa_scan *nfa_scan_alloc (struct nfa_state *start, size_t threads);
+void nfa_scan_free (struct nfa_scan *o);
+
+/*
+ * Tokens of the input chunk
+ */
+struct nfa_scan_chunk {
+	struct nfa_token *token;
+	size_t count;
+};
+
+/*
+ * The function nfa_scan splits the input into chunks and lexes them in
+ * parallel. Returns the array of chunks and stores the number of chunks
+ * into count, or returns NULL on allocation error. Concatenated in order
+ * the chunks contain the same tokens a sequential lexer returns for the
+ * input. Chunks are valid until the next call to nfa_scan, token texts
+ * point into the input.
+ *
+ * Note that zero-length match is treated as lexical error.
+ */
+const struct nfa_scan_chunk *
+nfa_scan (struct nfa_scan *o, const void *data, size_t size, size_t *count);
+
+/*
+ * The function nfa_scan_eof returns 1 if the whole input was lexed by the
+ * last call to nfa_scan, or zero on lexical error.
+ */
+int nfa_scan_eof (struct nfa_scan *o);
+
+#endif  /* PERUSE_NFA_SCAN_H */
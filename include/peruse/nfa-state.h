@@ -41,4 +41,24 @@ void nfa_state_color (struct nfa_state *o, int color);
  */
 size_t nfa_state_count (const struct nfa_state *o);
 
+/*
+ * NFA prefix: the map of bytes which can start a match, the flag which
+ * is set if NFA matches the empty string, and the literal (up to
+ * NFA_PREFIX_MAX bytes) every match starts with.
+ */
+#define NFA_PREFIX_MAX	16
+
+struct nfa_prefix {
+	unsigned char first[256];
+	int empty;
+	size_t len;
+	unsigned char text[NFA_PREFIX_MAX];
+};
+
+/*
+ * The function nfa_state_prefix extracts prefix of NFA. Returns 1 on
+ * success, or zero on allocation error.
+ */
+int nfa_state_prefix (struct nfa_state *o, struct nfa_prefix *p);
+
 #endif  /* PERUSE_NFA_STATE_H */
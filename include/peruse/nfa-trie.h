@@ -0,0 +1,44 @@
+/*
+ * Literal Trie Matcher
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_TRIE_H
+#define PERUSE_NFA_TRIE_H  1
+
+#include <stddef.h>
+
+/*
+ * The function nfa_trie_alloc creates empty literal trie, the function
+ * nfa_trie_free destroys it.
+ */
+struct nfa_trie *nfa_trie_alloc (void);
+void nfa_trie_free (struct nfa_trie *o);
+
+/*
+ * The function nfa_trie_add adds literal of the specified color to the
+ * trie. If the literal is in the trie already, then its color is kept:
+ * literals added earlier have a higher priority. Returns 1 on success,
+ * or zero on allocation error.
+ */
+int nfa_trie_add (struct nfa_trie *o, const void *text, size_t len,
+		  int color);
+
+/*
+ * Get total number of nodes in trie
+ */
+size_t nfa_trie_count (const struct nfa_trie *o);
+
+/*
+ * The functions nfa_trie_start and nfa_trie_step have the same semantics
+ * as ones of NFA processor. The trie is compiled into double-array form
+ * on the first start after literals were added, the start returns -1 on
+ * allocation error.
+ */
+int nfa_trie_start (struct nfa_trie *o);
+int nfa_trie_step  (struct nfa_trie *o, int c);
+
+#endif  /* PERUSE_NFA_TRIE_H */
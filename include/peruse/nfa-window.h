@@ -20,8 +20,10 @@ typedef size_t nfa_window_reader (void *to, size_t count, void *cookie);
 
 /*
  * The function nfa_window_alloc creates the NFA Input Window context.
- * If no maximum window size is specified, then the buffer size for
- * standard I/O is used.
+ * If no initial window size is specified, then the buffer size for
+ * standard I/O is used. The window grows when it is full and a fill is
+ * requested, thus data requested is always contiguous and is not limited
+ * by the initial size.
  *
  * The function nfa_window_free destroys the NFA Input Window context.
  */
@@ -29,9 +31,18 @@ struct nfa_window *nfa_window_alloc (size_t size, nfa_window_reader *read,
 				     void *cookie);
 void nfa_window_free (struct nfa_window *o);
 
+/*
+ * The function nfa_window_alloc_mmap creates the NFA Input Window context
+ * which maps the whole file read-only. Data in such window never moves,
+ * thus all pointers into window stay valid for the window lifetime.
+ * Returns NULL and sets errno to EINVAL if the file is not a regular one.
+ */
+struct nfa_window *nfa_window_alloc_mmap (int fd);
+
 /*
  * The function nfa_window_fill fills the buffer with new data. Returns
- * 1 on success, or zero on EOF or errors.
+ * 1 on success, or zero on EOF or errors. Note that fill can move data
+ * in the window, thus the region should be requested again.
  */
 int nfa_window_fill (struct nfa_window *o);
 
@@ -45,4 +56,18 @@ int nfa_window_fill (struct nfa_window *o);
 void *nfa_window_request (struct nfa_window *o, size_t *len);
 void  nfa_window_release (struct nfa_window *o, size_t  len);
 
+/*
+ * The function nfa_window_stats stores the window size and counters of
+ * reader calls, bytes read and bytes moved to the head of window by
+ * fill. Returns 1 if the counters are maintained (the library is built
+ * with PERUSE_STATS defined), zero otherwise.
+ */
+struct nfa_window_stats {
+	size_t size;		/* window size, bytes */
+	size_t reads, read;	/* reader calls and bytes read */
+	size_t moved;		/* bytes moved by fill */
+};
+
+int nfa_window_stats (const struct nfa_window *o, struct nfa_window_stats *s);
+
 #endif  /* PERUSE_NFA_WINDOW_H */
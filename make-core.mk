@@ -26,6 +26,10 @@ CFLAGS	+= `pkg-config $(DEPENDS) --cflags`
 LDFLAGS	+= `pkg-config $(DEPENDS) --libs`
 endif
 
+ifneq ($(LIBS),)
+LDFLAGS	+= $(LIBS)
+endif
+
 #
 # guarantie default target
 #
@@ -39,10 +43,11 @@ all:
 #
 
 HEADERS	= $(wildcard include/*.h include/*/*.h)
-SOURCES	= $(filter-out %-test.c %-tool.c %-service.c, $(wildcard *.c))
+SOURCES	= $(filter-out %-test.c %-bench.c %-tool.c %-service.c, $(wildcard *.c))
 OBJECTS	= $(patsubst %.c,%.o, $(SOURCES))
 
 TESTS	= $(patsubst %-test.c,%-test, $(wildcard *-test.c))
+BENCHES	= $(patsubst %-bench.c,%-bench, $(wildcard *-bench.c))
 TOOLS	= $(patsubst %-tool.c,%, $(wildcard *-tool.c))
 SERVICES = $(patsubst %-service.c,%, $(wildcard *-service.c))
 
@@ -86,7 +91,7 @@ $(PCFILE):
 ifneq ($(DEPENDS),)
 	@echo "Requires: $(DEPENDS)"			>> $@
 endif
-	@echo "Libs: -l$(LIBNAME)"			>> $@
+	@echo "Libs: -l$(LIBNAME) $(LIBS)"		>> $@
 	@echo "Cflags: -I$(INCROOT)"			>> $@
 
 install-static: $(AFILE) $(PCFILE)
@@ -132,6 +137,31 @@ clean-tests:
 
 endif  # build TESTS
 
+#
+# rules to manage benchmarks (ordinary programs, built and run on demand)
+#
+
+ifneq ($(BENCHES),)
+
+%-bench: %-bench.c
+	$(CC) $(CFLAGS) -o $@ $^ $(LDFLAGS)
+
+.PHONY: bench build-benches clean-benches
+
+clean:   clean-benches
+
+$(BENCHES): CFLAGS += -I$(CURDIR)/include
+$(BENCHES): $(AFILE)
+
+bench: build-benches
+	@for B in $(BENCHES); do ./$$B || exit 1; done
+
+build-benches: $(BENCHES)
+clean-benches:
+	$(RM) $(BENCHES)
+
+endif  # build BENCHES
+
 #
 # rules to manage tools (ordinary programs)
 #
@@ -0,0 +1,81 @@
+/*
+ * Name Table Interning Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/name-table.h>
+
+#include "bench.h"
+
+#define NAME_SIZE	16
+#define STREAM_SIZE	(4 << 20)
+
+/*
+ * Intern stream of identifiers drawn from vocabulary of count names, as
+ * lexer does for every identifier token
+ */
+static int run (struct bench *o, const void *arg)
+{
+	const size_t *count = arg;
+	struct name_table *t;
+	char *vocab;
+	const char *name;
+	size_t i, len;
+	double start;
+
+	if ((vocab = malloc (*count * NAME_SIZE)) == NULL)
+		return 0;
+
+	for (i = 0; i < *count; ++i) {
+		len = 1 + bench_rnd (NAME_SIZE - 1);
+
+		bench_fill (vocab + i * NAME_SIZE, len,
+			    "abcdefghijklmnopqrstuvwxyz_");
+		vocab[i * NAME_SIZE + len] = '\0';
+	}
+
+	if ((t = name_table_alloc ()) == NULL)
+		goto no_table;
+
+	start = bench_now ();
+
+	for (o->tokens = 0; o->tokens < STREAM_SIZE; ++o->tokens) {
+		name = vocab + bench_rnd (*count) * NAME_SIZE;
+
+		if (name_table_intern (t, name, 0) == 0)
+			goto no_intern;
+
+		o->bytes += strlen (name);
+	}
+
+	o->time = bench_now () - start;
+
+	name_table_free (t);
+	free (vocab);
+	return 1;
+no_intern:
+	name_table_free (t);
+no_table:
+	free (vocab);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	static const size_t count[] = { 100, 10000, 1000000 };
+	const char *name = "name-table";
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (count) / sizeof (count[0]); ++i) {
+		snprintf (test, sizeof (test), "vocab-%zu", count[i]);
+
+		if (!bench_run (name, test, run, count + i))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Name Table Test
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <peruse/name-table.h>
+
+#define COUNT	20000	/* names, the index grows many times */
+
+static void name_make (char *name, size_t i, int absent)
+{
+	sprintf (name, "%s%zu", absent ? "absent-" : "name-", i * 7919);
+}
+
+int main (int argc, char *argv[])
+{
+	struct name_table *o;
+	char name[32];
+	size_t i, id;
+
+	if ((o = name_table_alloc ()) == NULL) {
+		perror ("name-table-test");
+		return 1;
+	}
+
+	for (i = 0; i < COUNT; ++i) {
+		name_make (name, i, 0);
+
+		if ((id = name_table_intern (o, name, 0)) != i + 1) {
+			fprintf (stderr, "E: %s interned as %zu\n", name, id);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < COUNT; ++i) {  /* duplicates, strings of given length */
+		name_make (name, i, 0);
+		strcat (name, "-tail");
+
+		if ((id = name_table_intern (o, name, strlen (name) - 5)) != i + 1 ||
+		    name_table_lookup (o, name, strlen (name) - 5) != i + 1) {
+			fprintf (stderr, "E: duplicate %s gives %zu\n", name, id);
+			return 1;
+		}
+
+		name[strlen (name) - 5] = '\0';
+
+		if (strcmp (name_table_get (o, i + 1), name) != 0) {
+			fprintf (stderr, "E: name %zu is not %s\n", i + 1, name);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < COUNT; ++i) {
+		name_make (name, i, 1);
+
+		if ((id = name_table_lookup (o, name, 0)) != 0) {
+			fprintf (stderr, "E: absent %s found as %zu\n", name, id);
+			return 1;
+		}
+	}
+
+	if (name_table_max (o) != COUNT || name_table_get (o, 0) != NULL ||
+	    name_table_get (o, COUNT + 1) != NULL) {
+		fprintf (stderr, "E: table holds %zu names\n", name_table_max (o));
+		return 1;
+	}
+
+	printf ("name-table: %d names interned\n", COUNT);
+	name_table_free (o);
+	return 0;
+}
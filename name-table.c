@@ -12,9 +12,36 @@
 
 #include <peruse/name-table.h>
 
+#define NAME_CHUNK_SIZE	4096
+
+struct name_chunk {
+	struct name_chunk *next;
+	char data[];
+};
+
+struct name_entry {
+	const char *name;
+	size_t len;
+};
+
+/*
+ * Open addressing Robin Hood index: slot holds name id (zero if slot is
+ * empty) and its hash, entries are kept sorted by probe distance
+ */
+struct name_slot {
+	size_t hash, id;
+};
+
 struct name_table {
 	size_t last, avail;
-	char **name;
+	struct name_entry *name;
+
+	struct name_slot *slot;
+	size_t mask;
+
+	struct name_chunk *chunk;	/* string arena */
+	char *cursor;
+	size_t left;
 };
 
 struct name_table *name_table_alloc (void)
@@ -26,19 +53,39 @@ struct name_table *name_table_alloc (void)
 
 	o->last  = 0;
 	o->avail = 8;
+	o->mask  = 15;
+
+	o->chunk  = NULL;
+	o->cursor = NULL;
+	o->left   = 0;
+
+	if ((o->name = malloc (sizeof (o->name[0]) * o->avail)) == NULL)
+		goto no_name;
 
-	if ((o->name = malloc (sizeof (o->name[0]) * o->avail)) != NULL)
-		return o;
+	if ((o->slot = calloc (o->mask + 1, sizeof (o->slot[0]))) == NULL)
+		goto no_slot;
 
+	return o;
+no_slot:
+	free (o->name);
+no_name:
 	free (o);
 	return NULL;
 }
 
 void name_table_free (struct name_table *o)
 {
+	struct name_chunk *next;
+
 	if (o == NULL)
 		return;
 
+	for (; o->chunk != NULL; o->chunk = next) {
+		next = o->chunk->next;
+		free (o->chunk);
+	}
+
+	free (o->slot);
 	free (o->name);
 	free (o);
 }
@@ -48,24 +95,149 @@ size_t name_table_max (struct name_table *o)
 	return o->last;
 }
 
-static char *name_clone (const char *name, size_t len)
+/*
+ * Word-at-a-time multiplicative hash
+ */
+static size_t name_hash (const char *name, size_t len)
+{
+	const size_t k = (size_t) 0x9e3779b97f4a7c15ULL;
+	size_t hash = len * k, w;
+
+	for (; len >= sizeof (w); name += sizeof (w), len -= sizeof (w)) {
+		memcpy (&w, name, sizeof (w));
+		hash = (hash ^ w) * k;
+	}
+
+	if (len > 0) {
+		w = 0;
+		memcpy (&w, name, len);
+		hash = (hash ^ w) * k;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
+static size_t name_dist (const struct name_table *o, size_t pos)
+{
+	return (pos - o->slot[pos].hash) & o->mask;
+}
+
+static size_t
+name_find (const struct name_table *o, const char *name, size_t len,
+	   size_t hash)
+{
+	const struct name_entry *e;
+	size_t pos, dist;
+
+	for (
+		pos = hash & o->mask, dist = 0;;
+		pos = (pos + 1) & o->mask, ++dist
+	) {
+		if (o->slot[pos].id == 0 || name_dist (o, pos) < dist)
+			return 0;
+
+		if (o->slot[pos].hash != hash)
+			continue;
+
+		e = o->name + o->slot[pos].id - 1;
+
+		if (e->len == len && memcmp (e->name, name, len) == 0)
+			return o->slot[pos].id;
+	}
+}
+
+/*
+ * Insert name id into index, the index must have a free slot
+ */
+static void name_index (struct name_table *o, size_t hash, size_t id)
+{
+	struct name_slot s = { hash, id }, t;
+	size_t pos, dist, d;
+
+	for (
+		pos = hash & o->mask, dist = 0;;
+		pos = (pos + 1) & o->mask, ++dist
+	) {
+		if (o->slot[pos].id == 0) {
+			o->slot[pos] = s;
+			return;
+		}
+
+		/* carry on the displaced entry with its own distance */
+		if ((d = name_dist (o, pos)) < dist) {
+			t = o->slot[pos], o->slot[pos] = s, s = t;
+			dist = d;
+		}
+	}
+}
+
+/*
+ * Keep load factor not greater than 1/2
+ */
+static int name_reserve (struct name_table *o)
+{
+	struct name_slot *old = o->slot;
+	size_t size = o->mask + 1, i;
+
+	if (o->last + 1 <= size / 2)
+		return 1;
+
+	if (size * 2 < size || size * 2 > SIZE_MAX / sizeof (old[0])) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	if ((o->slot = calloc (size * 2, sizeof (old[0]))) == NULL) {
+		o->slot = old;
+		return 0;
+	}
+
+	o->mask = size * 2 - 1;
+
+	for (i = 0; i < size; ++i)
+		if (old[i].id != 0)
+			name_index (o, old[i].hash, old[i].id);
+
+	free (old);
+	return 1;
+}
+
+static char *name_clone (struct name_table *o, const char *name, size_t len)
 {
+	struct name_chunk *c;
+	size_t size = len + 1 > NAME_CHUNK_SIZE ? len + 1 : NAME_CHUNK_SIZE;
 	char *p;
 
-	if (len == 0)
-		len = strlen (name);
+	if (len + 1 > o->left) {
+		if (len >= SIZE_MAX - sizeof (*c)) {
+			errno = ENOMEM;
+			return NULL;
+		}
 
-	if ((p = malloc (len + 1)) == NULL)
-		return NULL;
+		if ((c = malloc (sizeof (*c) + size)) == NULL)
+			return NULL;
+
+		c->next   = o->chunk;
+		o->chunk  = c;
+		o->cursor = c->data;
+		o->left   = size;
+	}
 
-	strncpy (p, name, len + 1);
+	p = o->cursor;
+	memcpy (p, name, len);
+	p[len] = '\0';
+
+	o->cursor += len + 1;
+	o->left   -= len + 1;
 	return p;
 }
 
-size_t name_table_add (struct name_table *o, const char *name, size_t len)
+static size_t
+name_insert (struct name_table *o, const char *name, size_t len, size_t hash,
+	     int index)
 {
 	size_t curr, next;
-	char **p;
+	struct name_entry *p;
 
 	if (o->last == o->avail) {
 		curr = o->avail * sizeof (o->name[0]);
@@ -82,16 +254,62 @@ size_t name_table_add (struct name_table *o, const char *name, size_t len)
 		o->avail *= 2;
 	}
 
-	if ((o->name[o->last] = name_clone (name, len)) == NULL)
+	if (index && !name_reserve (o))
+		return 0;
+
+	p = o->name + o->last;
+
+	if ((p->name = name_clone (o, name, len)) == NULL)
 		return 0;
 
+	p->len = len;
+
+	if (index)
+		name_index (o, hash, o->last + 1);
+
 	return ++o->last;
 }
 
+size_t name_table_add (struct name_table *o, const char *name, size_t len)
+{
+	size_t hash;
+
+	if (len == 0)
+		len = strlen (name);
+
+	hash = name_hash (name, len);
+
+	return name_insert (o, name, len, hash,
+			    name_find (o, name, len, hash) == 0);
+}
+
+size_t name_table_lookup (struct name_table *o, const char *name, size_t len)
+{
+	if (len == 0)
+		len = strlen (name);
+
+	return name_find (o, name, len, name_hash (name, len));
+}
+
+size_t name_table_intern (struct name_table *o, const char *name, size_t len)
+{
+	size_t hash, id;
+
+	if (len == 0)
+		len = strlen (name);
+
+	hash = name_hash (name, len);
+
+	if ((id = name_find (o, name, len, hash)) != 0)
+		return id;
+
+	return name_insert (o, name, len, hash, 1);
+}
+
 const char *name_table_get (struct name_table *o, size_t i)
 {
 	if (i == 0 || i > o->last)
 		return NULL;
 
-	return o->name[i - 1];
+	return o->name[i - 1].name;
 }
@@ -0,0 +1,189 @@
+/*
+ * NFA Processor Engines Cross-Check
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+static struct nfa_rule lexer[] = {
+	{ lexer + 1,	"if",			10 },
+	{ lexer + 2,	"then",			11 },
+	{ lexer + 3,	"else",			12 },
+
+	{ lexer + 4,	"[ \t\n]+",		40 },
+	{ lexer + 5,	"0|(1[01]*)",		41 },
+	{ NULL,		"[ab](-?[a-z0-9])*",	42 },
+};
+
+static struct nfa_rule alt[] = {
+	{ alt + 1,	"(a|b)*a(a|b)(a|b)(a|b)",	1 },
+	{ alt + 2,	"b+",				2 },
+	{ NULL,		"\n+",				3 },
+};
+
+static struct nfa_rule code[] = {
+	{ code + 1,	"if|else|while|for|return",	1 },
+	{ code + 2,	"[a-z_][a-z0-9_]*",		2 },
+	{ code + 3,	"[0-9]+|0x[0-9a-f]+",		3 },
+	{ code + 4,	"\"[ !#-~]*\"",			4 },
+	{ code + 5,	"#[ -~]*",			5 },
+	{ code + 6,	"[-+*/=;(){},<>]|<=|>=|==",	6 },
+	{ NULL,		"[ \t\n]+",			7 },
+};
+
+/* more than 64 character states: simulated state by state */
+static struct nfa_rule words[] = {
+	{ words + 1,	"alpha|bravo|charlie|delta|echo|foxtrot|golf|hotel",	1 },
+	{ words + 2,	"india|juliet|kilo|lima|mike|november|oscar|papa",	2 },
+	{ words + 3,	"[a-z]+",						3 },
+	{ NULL,		"[ \n]+",						4 },
+};
+
+static const struct bits_case {
+	const char *name;
+	const struct nfa_rule *rules;
+	const char *alphabet;
+} rule_set[] = {
+	{ "lexer", lexer, "ifthenlsab-0123z \n" },
+	{ "alt",   alt,   "aaabbb\n" },
+	{ "code",  code,  "abefhilorstuwx_0x19 \"#+-=<>;(){},\n" },
+	{ "words", words, "abcdefghijklmnoprstuvx \n" },
+};
+
+#define INPUT_SIZE	(64 << 10)
+
+static unsigned long seed = 1;
+
+static size_t rnd (size_t limit)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) % limit;
+}
+
+enum proc_type {
+	PROC_DFA,	/* default lazy DFA cache */
+	PROC_BITS,	/* no cache: bit-parallel engine up to 64 states */
+	PROC_MIXED,	/* tiny cache toggled on and off in the middle */
+	PROC_TYPES,
+};
+
+static const char *type_name[PROC_TYPES] = { "dfa", "bits", "mixed" };
+
+/*
+ * Returns the length of the longest match from pos and stores its color,
+ * or returns zero on lexical error
+ */
+static size_t
+scan_token (struct nfa_proc *o, enum proc_type type, const char *data,
+	    size_t size, size_t pos, int *color)
+{
+	size_t i, len = 0;
+	int c;
+
+	nfa_proc_start (o);
+
+	for (i = pos; i < size;) {
+		if (type == PROC_MIXED && rnd (7) == 0)
+			nfa_proc_set_cache (o, rnd (2) ? 0 : 600);
+
+		if ((c = nfa_proc_step (o, (unsigned char) data[i++])) < 0)
+			break;
+
+		if (c > 0) {
+			len    = i - pos;
+			*color = c;
+		}
+	}
+
+	return len;
+}
+
+/*
+ * Splits the input into the longest matches, a byte which cannot start
+ * a match is traced as an error and skipped
+ */
+static int
+trace (const struct nfa_rule *rules, enum proc_type type, const char *data,
+       size_t size, FILE *to)
+{
+	struct nfa_proc *o;
+	size_t pos, len;
+	int color;
+
+	if ((o = nfa_proc_alloc (nfa_parse_rules (rules))) == NULL)
+		return 0;
+
+	if (type != PROC_DFA)
+		nfa_proc_set_cache (o, 0);
+
+	for (pos = 0; pos < size; pos += len)
+		if ((len = scan_token (o, type, data, size, pos, &color)) > 0)
+			fprintf (to, "%d %zu\n", color, len);
+		else {
+			fprintf (to, "error\n");
+			len = 1;
+		}
+
+	nfa_proc_free (o);
+	return 1;
+}
+
+static int run (const struct bits_case *c, const char *data, size_t size)
+{
+	char *text[PROC_TYPES];
+	size_t len[PROC_TYPES];
+	FILE *to;
+	int type, ok = 1;
+
+	for (type = 0; type < PROC_TYPES; ++type)
+		if ((to = open_memstream (text + type, len + type)) == NULL ||
+		    !trace (c->rules, type, data, size, to) ||
+		    fclose (to) != 0) {
+			perror ("nfa-bits-test");
+			return 0;
+		}
+
+	for (type = 1; type < PROC_TYPES; ++type)
+		if (len[type] != len[0] || memcmp (text[type], text[0],
+						   len[0]) != 0) {
+			fprintf (stderr, "E: %s: %s engine token stream "
+				 "differs\n", c->name, type_name[type]);
+			ok = 0;
+		}
+
+	if (ok)
+		printf ("bits: %s: tokens without cache match\n", c->name);
+
+	for (type = 0; type < PROC_TYPES; ++type)
+		free (text[type]);
+
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	char data[INPUT_SIZE];
+	const struct bits_case *c;
+	size_t i, n, k;
+
+	for (i = 0; i < sizeof (rule_set) / sizeof (rule_set[0]); ++i) {
+		c = rule_set + i;
+		n = strlen (c->alphabet);
+
+		for (k = 0; k < sizeof (data); ++k)
+			data[k] = c->alphabet[rnd (n)];
+
+		if (!run (c, data, sizeof (data)))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * DFA Image Load Startup Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <sys/stat.h>
+
+#include <peruse/nfa-dfa.h>
+#include <peruse/nfa-parse.h>
+
+#include "bench.h"
+
+/*
+ * Keyword and number-like rules, each one is unique. Texts are stored
+ * after the rules in the same allocation.
+ */
+static struct nfa_rule *rules_alloc (size_t count)
+{
+	static const char *format[] = {
+		"kw%zu", "(0x|0)%zu[0-9]+", "%zu(a|b)?c", "op%zu[-+]",
+	};
+	struct nfa_rule *o;
+	char *text;
+	size_t i;
+
+	if ((o = malloc (count * (sizeof (o[0]) + BENCH_RE_SIZE))) == NULL)
+		return NULL;
+
+	text = (char *) (o + count);
+
+	for (i = 0; i < count; ++i) {
+		o[i].next  = i + 1 < count ? o + i + 1 : NULL;
+		o[i].re    = text + i * BENCH_RE_SIZE;
+		o[i].color = 1 + i;
+
+		snprintf (o[i].re, BENCH_RE_SIZE, format[i % 4], i);
+	}
+
+	return o;
+}
+
+/*
+ * Compile rules as every process does on startup, or load the same DFA
+ * from the image saved before. The image size is counted as bytes and
+ * DFA states are counted as tokens.
+ */
+static int run (struct bench *o, size_t count, int load)
+{
+	struct nfa_rule *rules;
+	struct nfa_state *nfa;
+	struct nfa_dfa *dfa;
+	struct stat st;
+	FILE *f;
+	double start;
+
+	if ((rules = rules_alloc (count)) == NULL)
+		return 0;
+
+	if ((f = tmpfile ()) == NULL)
+		goto no_file;
+
+	start = bench_now ();
+
+	if ((nfa = nfa_parse_rules (rules)) == NULL ||
+	    (dfa = nfa_dfa_alloc (nfa)) == NULL)
+		goto no_dfa;
+
+	o->time   = bench_now () - start;
+	o->tokens = nfa_dfa_count (dfa);
+
+	if (!nfa_dfa_save (dfa, fileno (f)) || fstat (fileno (f), &st) != 0)
+		goto no_save;
+
+	o->bytes = st.st_size;
+
+	if (load) {
+		nfa_dfa_free (dfa);
+		start = bench_now ();
+
+		if ((dfa = nfa_dfa_load (fileno (f))) == NULL)
+			goto no_dfa;
+
+		o->time = bench_now () - start;
+	}
+
+	nfa_dfa_free (dfa);
+	fclose (f);
+	free (rules);
+	return 1;
+no_save:
+	nfa_dfa_free (dfa);
+no_dfa:
+	fclose (f);
+no_file:
+	free (rules);
+	return 0;
+}
+
+static int run_compile (struct bench *o, const void *arg)
+{
+	const size_t *count = arg;
+
+	return run (o, *count, 0);
+}
+
+static int run_load (struct bench *o, const void *arg)
+{
+	const size_t *count = arg;
+
+	return run (o, *count, 1);
+}
+
+int main (int argc, char *argv[])
+{
+	static const size_t count[] = { 100, 1000, 10000 };
+	const char *name = "nfa-dfa";
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (count) / sizeof (count[0]); ++i) {
+		snprintf (test, sizeof (test), "compile-%zu", count[i]);
+
+		if (!bench_run (name, test, run_compile, count + i))
+			return 1;
+
+		snprintf (test, sizeof (test), "load-%zu", count[i]);
+
+		if (!bench_run (name, test, run_load, count + i))
+			return 1;
+	}
+
+	return 0;
+}
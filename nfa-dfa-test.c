@@ -0,0 +1,80 @@
+/*
+ * RE to DFA compiler and DFA matcher Sample
+ *
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+
+#include <peruse/nfa-dfa.h>
+#include <peruse/nfa-parse.h>
+
+static int nfa_dfa_match (struct nfa_dfa *o, const char *s)
+{
+	int state = nfa_dfa_start (o);
+
+	for (; *s != '\0'; ++s)
+		if ((state = nfa_dfa_step (o, (unsigned char) *s)) < 0)
+			return 0;
+
+	return state > 0;
+}
+
+/*
+ * Match with DFA image mapped from file, as worker processes do
+ */
+static struct nfa_dfa *dfa_reload (struct nfa_dfa *o)
+{
+	FILE *f;
+	struct nfa_dfa *dfa = NULL;
+
+	if ((f = tmpfile ()) == NULL)
+		goto no_file;
+
+	if (nfa_dfa_save (o, fileno (f)))
+		dfa = nfa_dfa_load (fileno (f));
+
+	fclose (f);
+no_file:
+	nfa_dfa_free (o);
+	return dfa;
+}
+
+int main (int argc, char *argv[])
+{
+	struct nfa_state *nfa;
+	struct nfa_dfa *dfa;
+	int i;
+
+	if (argc < 3) {
+		fprintf (stderr, "usage:\n\tnfa-dfa-test RE string...\n");
+		return 1;
+	}
+
+	if ((nfa = nfa_parse_re (argv[1], 1)) == NULL) {
+		fprintf (stderr, "nfa-dfa-test: cannot compile RE\n");
+		return 1;
+	}
+
+	if ((dfa = nfa_dfa_alloc (nfa)) == NULL) {
+		fprintf (stderr, "E: cannot compile NFA to DFA\n");
+		return 1;
+	}
+
+	fprintf (stderr, "I: Total number of DFA states = %zu\n",
+		 nfa_dfa_count (dfa));
+
+	if ((dfa = dfa_reload (dfa)) == NULL) {
+		fprintf (stderr, "E: cannot save and load DFA\n");
+		return 1;
+	}
+
+	for (i = 2; i < argc; ++i)
+		if (nfa_dfa_match (dfa, argv[i]))
+			printf ("%s\n", argv[i]);
+
+	nfa_dfa_free (dfa);
+	return 0;
+}
@@ -0,0 +1,804 @@
+/*
+ * Thompson NFA to DFA compiler
+ *
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <peruse/bitset.h>
+#include <peruse/nfa-dfa.h>
+
+#include "nfa-state.h"
+
+struct nfa_dfa {
+	size_t count, start, state;
+	int *color;		/* rule color, -1 for dead state */
+	unsigned *move;		/* count x classes transitions */
+
+	size_t classes;		/* number of byte classes */
+	unsigned char class[256];	/* byte to class map */
+
+	void *image;		/* mapped image, tables point into it */
+	size_t size;
+};
+
+/*
+ * Subset construction
+ */
+struct dfa_builder {
+	const struct nfa_state **map;
+	struct nfa_closure closure;
+	size_t states, size;	/* number of NFA states, set size in longs */
+
+	size_t classes;		/* number of byte classes */
+	unsigned char class[256];	/* byte to class map */
+	int first[256];		/* first byte of class */
+
+	size_t count, avail;	/* number of DFA states built and allocated */
+	long *sets;
+	int *color;
+	unsigned *move;
+
+	size_t *table, order;	/* hash table of DFA state index plus one */
+};
+
+static int builder_init (struct dfa_builder *b, struct nfa_state *nfa)
+{
+	const size_t bits = sizeof (long) * CHAR_BIT;
+	const struct nfa_state *p;
+	size_t i;
+
+	nfa_state_order (nfa);
+
+	b->states = nfa_state_count (nfa);
+	b->size   = (b->states + bits - 1) / bits;
+
+	b->classes = nfa_state_classes (nfa, b->class);
+
+	for (i = 256; i > 0; --i)
+		b->first[b->class[i - 1]] = i - 1;
+
+	b->count = b->avail = 0;
+	b->sets  = NULL;
+	b->color = NULL;
+	b->move  = NULL;
+	b->table = NULL;
+	b->order = 0;
+
+	b->closure.first  = b->closure.list = NULL;
+	b->closure.accept = NULL;
+
+	if ((b->map = malloc (b->states * sizeof (b->map[0]))) == NULL)
+		return 0;
+
+	for (p = nfa, i = 0; p != NULL; p = p->next, ++i)
+		b->map[i] = p;
+
+	return nfa_closure_init (&b->closure, nfa, b->states);
+}
+
+static void builder_fini (struct dfa_builder *b)
+{
+	free (b->table);
+	free (b->move);
+	free (b->color);
+	free (b->sets);
+	nfa_closure_fini (&b->closure);
+	free (b->map);
+}
+
+static int builder_grow (struct dfa_builder *b)
+{
+	const size_t avail = b->avail == 0 ? 64 : b->avail * 2;
+	long *sets;
+	int *color;
+	unsigned *move;
+
+	if (avail > UINT_MAX)
+		return 0;
+
+	if ((sets = realloc (b->sets, avail * b->size * sizeof (sets[0]))) == NULL)
+		return 0;
+
+	b->sets = sets;
+
+	if ((color = realloc (b->color, avail * sizeof (color[0]))) == NULL)
+		return 0;
+
+	b->color = color;
+
+	if ((move = realloc (b->move,
+			     avail * b->classes * sizeof (move[0]))) == NULL)
+		return 0;
+
+	b->move  = move;
+	b->avail = avail;
+	return 1;
+}
+
+static size_t builder_hash (const struct dfa_builder *b, const long *set,
+			    int color)
+{
+	return (bitset_hash (set, b->states) ^ color) * 16777619;
+}
+
+static int builder_rehash (struct dfa_builder *b)
+{
+	const size_t order = b->order == 0 ? 7 : b->order + 1;
+	const size_t mask = ((size_t) 1 << order) - 1;
+	size_t *table, i, j;
+
+	if ((table = calloc (mask + 1, sizeof (table[0]))) == NULL)
+		return 0;
+
+	for (i = 0; i < b->count; ++i) {
+		j = builder_hash (b, b->sets + i * b->size, b->color[i]);
+
+		for (j &= mask; table[j] != 0; j = (j + 1) & mask) {}
+
+		table[j] = i + 1;
+	}
+
+	free (b->table);
+	b->table = table;
+	b->order = order;
+	return 1;
+}
+
+/*
+ * Returns index of DFA state for the set of NFA states, or -1 on error
+ */
+static size_t builder_intern (struct dfa_builder *b, const long *set, int color)
+{
+	const size_t bytes = b->size * sizeof (set[0]);
+	size_t mask, i, j;
+
+	if ((b->table == NULL || b->count * 2 >= ((size_t) 1 << b->order)) &&
+	    !builder_rehash (b))
+		return -1;
+
+	mask = ((size_t) 1 << b->order) - 1;
+
+	for (
+		j = builder_hash (b, set, color) & mask;
+		(i = b->table[j]) != 0;
+		j = (j + 1) & mask
+	)
+		if (b->color[i - 1] == color &&
+		    bitset_equal (b->sets + (i - 1) * b->size, set, b->states))
+			return i - 1;
+
+	if (b->count == b->avail && !builder_grow (b))
+		return -1;
+
+	i = b->count++;
+	memcpy (b->sets + i * b->size, set, bytes);
+	b->color[i] = color;
+	b->table[j] = i + 1;
+	return i;
+}
+
+/*
+ * Adds closure of state (or start state closure if index is equal to the
+ * number of states) to the set. Returns color if stop state reachable,
+ * zero otherwise.
+ */
+static int builder_add (struct dfa_builder *b, long *set, size_t index)
+{
+	const struct nfa_closure *c = &b->closure;
+	size_t i;
+
+	for (i = c->first[index]; i < c->first[index + 1]; ++i)
+		bitset_add (set, c->list[i]);
+
+	return c->accept[index];
+}
+
+/*
+ * Moves from one set of states to next one. Returns -1 if no one state
+ * accepts the input, node color on match, zero otherwise.
+ */
+static int builder_step (struct dfa_builder *b, const long *from, long *to,
+			 int c)
+{
+	size_t i;
+	const struct nfa_state *s;
+	int color, match = 0, error = 1;
+
+	bitset_clear (to, b->states);
+
+	bitset_foreach (i, from, b->states) {
+		s = b->map[i];
+
+		if (s->from <= c && c <= s->to) {
+			error = 0;
+			color = builder_add (b, to, i);
+
+			if (match == 0)
+				match = color;
+		}
+	}
+
+	return error ? -1 : match;
+}
+
+/*
+ * Builds all reachable DFA states: state 0 is the dead state, and
+ * state 1 is the start state.
+ */
+static int builder_run (struct dfa_builder *b)
+{
+	struct bitset scratch;
+	long *set;
+	size_t i, k, next;
+	int c, color;
+
+	if (!bitset_init (&scratch, b->states))
+		return 0;
+
+	set = bitset_data (&scratch);
+
+	if (builder_intern (b, set, -1) != 0)
+		goto error;
+
+	color = builder_add (b, set, b->states);
+
+	if (builder_intern (b, set, color) != 1)
+		goto error;
+
+	for (k = 0; k < b->classes; ++k)
+		b->move[k] = 0;
+
+	for (i = 1; i < b->count; ++i)
+		for (k = 0; k < b->classes; ++k) {
+			c     = b->first[k];
+			color = builder_step (b, b->sets + i * b->size, set, c);
+			next  = color < 0 ? 0 : builder_intern (b, set, color);
+
+			if (next == (size_t) -1)
+				goto error;
+
+			b->move[i * b->classes + k] = next;
+		}
+
+	bitset_fini (&scratch);
+	return 1;
+error:
+	bitset_fini (&scratch);
+	return 0;
+}
+
+/*
+ * Hopcroft minimization
+ */
+struct dfa_partition {
+	size_t count;		/* number of blocks */
+	size_t *elem, *loc;	/* states ordered by blocks, state positions */
+	size_t *block;		/* state blocks */
+	size_t *first, *last;	/* block ranges */
+	size_t *marked;		/* number of marked states in block */
+};
+
+static int part_init (struct dfa_partition *o, size_t count)
+{
+	const size_t n = count == 0 ? 1 : count;
+
+	o->count  = 0;
+	o->elem   = malloc (n * sizeof (o->elem[0]));
+	o->loc    = malloc (n * sizeof (o->loc[0]));
+	o->block  = malloc (n * sizeof (o->block[0]));
+	o->first  = malloc (n * sizeof (o->first[0]));
+	o->last   = malloc (n * sizeof (o->last[0]));
+	o->marked = calloc (n,  sizeof (o->marked[0]));
+
+	return o->elem != NULL && o->loc != NULL && o->block != NULL &&
+	       o->first != NULL && o->last != NULL && o->marked != NULL;
+}
+
+static void part_fini (struct dfa_partition *o)
+{
+	free (o->marked);
+	free (o->last);
+	free (o->first);
+	free (o->block);
+	free (o->loc);
+	free (o->elem);
+}
+
+struct part_item {
+	int color;
+	size_t state;
+};
+
+static int part_cmp (const void *a, const void *b)
+{
+	const struct part_item *x = a, *y = b;
+
+	if (x->color != y->color)
+		return x->color < y->color ? -1 : 1;
+
+	return x->state < y->state ? -1 : x->state > y->state;
+}
+
+/* initial partition: states with different colors are distinguishable */
+static int part_split_colors (struct dfa_partition *o, const int *color,
+			      size_t count)
+{
+	struct part_item *item;
+	size_t i, s;
+
+	if ((item = malloc (count * sizeof (item[0]))) == NULL)
+		return 0;
+
+	for (i = 0; i < count; ++i) {
+		item[i].color = color[i];
+		item[i].state = i;
+	}
+
+	qsort (item, count, sizeof (item[0]), part_cmp);
+
+	for (i = 0; i < count; ++i) {
+		s = o->elem[i] = item[i].state;
+
+		if (i == 0 || item[i].color != item[i - 1].color) {
+			o->first[o->count] = i;
+			++o->count;
+		}
+
+		o->loc[s]   = i;
+		o->block[s] = o->count - 1;
+		o->last[o->count - 1] = i + 1;
+	}
+
+	free (item);
+	return 1;
+}
+
+static void part_mark (struct dfa_partition *o, size_t s, size_t *touched,
+		       size_t *ntouched)
+{
+	const size_t b = o->block[s];
+	const size_t pos = o->first[b] + o->marked[b];
+	size_t t;
+
+	if (o->loc[s] < pos)
+		return;  /* already marked */
+
+	t = o->elem[pos];
+	o->elem[o->loc[s]] = t;
+	o->loc[t] = o->loc[s];
+	o->elem[pos] = s;
+	o->loc[s] = pos;
+
+	if (o->marked[b]++ == 0)
+		touched[(*ntouched)++] = b;
+}
+
+struct dfa_work {
+	size_t *stack, count;	/* pending (block, class) splitters */
+	char *pending;		/* splitters in stack */
+	size_t classes;
+};
+
+static void work_push (struct dfa_work *w, size_t block, size_t k)
+{
+	const size_t x = block * w->classes + k;
+
+	if (w->pending[x])
+		return;
+
+	w->pending[x] = 1;
+	w->stack[w->count++] = x;
+}
+
+static int dfa_minimize (struct dfa_partition *o, const struct dfa_builder *d)
+{
+	const size_t count = d->count, classes = d->classes;
+	const size_t size = count * classes;
+	const unsigned *move = d->move;
+	size_t *inv, *from, *members, *touched, ntouched;
+	struct dfa_work w;
+	size_t i, j, k, x, b, c, y, z, n;
+	int ok = 0;
+
+	inv     = malloc (size * sizeof (inv[0]));
+	from    = calloc (size + 1, sizeof (from[0]));
+	members = malloc (count * sizeof (members[0]));
+	touched = malloc (count * sizeof (touched[0]));
+	w.stack = malloc (size * sizeof (w.stack[0]));
+	w.pending = calloc (size, sizeof (w.pending[0]));
+	w.count = 0;
+	w.classes = classes;
+
+	if (inv == NULL || from == NULL || members == NULL ||
+	    touched == NULL || w.stack == NULL || w.pending == NULL)
+		goto error;
+
+	/* inverse transitions: from[c * count + t] indexes predecessors */
+	for (i = 0; i < count; ++i)
+		for (c = 0; c < classes; ++c)
+			++from[c * count + move[i * classes + c] + 1];
+
+	for (x = 0; x < size; ++x)
+		from[x + 1] += from[x];
+
+	for (i = 0; i < count; ++i)
+		for (c = 0; c < classes; ++c) {
+			x = c * count + move[i * classes + c];
+			inv[from[x]++] = i;
+		}
+
+	for (x = size; x > 0; --x)
+		from[x] = from[x - 1];
+
+	from[0] = 0;
+
+	if (!part_split_colors (o, d->color, count))
+		goto error;
+
+	for (b = 0; b < o->count; ++b)
+		for (c = 0; c < classes; ++c)
+			work_push (&w, b, c);
+
+	while (w.count > 0) {
+		x = w.stack[--w.count];
+		b = x / classes;
+		c = x % classes;
+		w.pending[x] = 0;
+
+		/* copy splitter as marking reorders states in blocks */
+		for (n = 0, i = o->first[b]; i < o->last[b]; ++i)
+			members[n++] = o->elem[i];
+
+		for (ntouched = 0, i = 0; i < n; ++i) {
+			x = c * count + members[i];
+
+			for (j = from[x]; j < from[x + 1]; ++j)
+				part_mark (o, inv[j], touched, &ntouched);
+		}
+
+		for (k = 0; k < ntouched; ++k) {
+			y = touched[k];
+
+			if (o->marked[y] == o->last[y] - o->first[y]) {
+				o->marked[y] = 0;
+				continue;
+			}
+
+			z = o->count++;
+			o->first[z] = o->first[y];
+			o->last[z]  = o->first[y] + o->marked[y];
+			o->first[y] = o->last[z];
+			o->marked[y] = 0;
+
+			for (i = o->first[z]; i < o->last[z]; ++i)
+				o->block[o->elem[i]] = z;
+
+			for (c = 0; c < classes; ++c)
+				if (w.pending[y * classes + c] ||
+				    o->last[z] - o->first[z] <=
+				    o->last[y] - o->first[y])
+					work_push (&w, z, c);
+				else
+					work_push (&w, y, c);
+		}
+	}
+
+	ok = 1;
+error:
+	free (w.pending);
+	free (w.stack);
+	free (touched);
+	free (members);
+	free (from);
+	free (inv);
+	return ok;
+}
+
+/*
+ * Builds final DFA from minimization result: the block of dead state
+ * becomes state 0, and the block of start state becomes state 1.
+ */
+static struct nfa_dfa *dfa_build (struct dfa_partition *p,
+				  const struct dfa_builder *b)
+{
+	struct nfa_dfa *o;
+	size_t *index, i, s, c, next;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	o->count = p->count;
+	o->start = o->state = 1;
+	o->image = NULL;
+	o->classes = b->classes;
+	memcpy (o->class, b->class, sizeof (o->class));
+	o->color = malloc (o->count * sizeof (o->color[0]));
+	o->move  = malloc (o->count * b->classes * sizeof (o->move[0]));
+	index    = malloc (o->count * sizeof (index[0]));
+
+	if (o->color == NULL || o->move == NULL || index == NULL)
+		goto error;
+
+	for (i = 0; i < o->count; ++i)
+		index[i] = -1;
+
+	index[p->block[0]] = 0;
+	index[p->block[1]] = 1;
+
+	for (next = 2, i = 0; i < o->count; ++i)
+		if (index[i] == (size_t) -1)
+			index[i] = next++;
+
+	for (i = 0; i < o->count; ++i) {
+		s = p->elem[p->first[i]];  /* block representative */
+
+		o->color[index[i]] = b->color[s];
+
+		for (c = 0; c < b->classes; ++c)
+			o->move[index[i] * b->classes + c] =
+				index[p->block[b->move[s * b->classes + c]]];
+	}
+
+	free (index);
+	return o;
+error:
+	free (index);
+	nfa_dfa_free (o);
+	return NULL;
+}
+
+/*
+ * The DFA constructor captures NFA, no one should try to use the NFA
+ * passed to the constructor.
+ */
+struct nfa_dfa *nfa_dfa_alloc (struct nfa_state *nfa)
+{
+	struct dfa_builder b;
+	struct dfa_partition p;
+	struct nfa_dfa *o = NULL;
+
+	if (!builder_init (&b, nfa) || !builder_run (&b))
+		goto no_build;
+
+	if (!part_init (&p, b.count) ||
+	    !dfa_minimize (&p, &b))
+		goto no_part;
+
+	o = dfa_build (&p, &b);
+no_part:
+	part_fini (&p);
+no_build:
+	builder_fini (&b);
+	nfa_state_free (nfa);
+	return o;
+}
+
+void nfa_dfa_free (struct nfa_dfa *o)
+{
+	if (o == NULL)
+		return;
+
+	if (o->image != NULL)
+		munmap (o->image, o->size);
+	else {
+		free (o->move);
+		free (o->color);
+	}
+
+	free (o);
+}
+
+size_t nfa_dfa_count (const struct nfa_dfa *o)
+{
+	return o->count;
+}
+
+size_t nfa_dfa_size (const struct nfa_dfa *o)
+{
+	if (o->image != NULL)
+		return o->size;
+
+	return sizeof (*o) + o->count * (sizeof (o->color[0]) +
+					 o->classes * sizeof (o->move[0]));
+}
+
+int nfa_dfa_color (const struct nfa_dfa *o, size_t state)
+{
+	return o->color[state];
+}
+
+size_t nfa_dfa_move (const struct nfa_dfa *o, size_t state, int c)
+{
+	return o->move[state * o->classes + o->class[c & 0xff]];
+}
+
+/*
+ * returns node color on match (stop state reached), zero otherwise
+ */
+int nfa_dfa_start (struct nfa_dfa *o)
+{
+	o->state = o->start;
+	return o->color[o->state];
+}
+
+/*
+ * returns -1 on error (no match), node color on match, zero otherwise
+ */
+int nfa_dfa_step (struct nfa_dfa *o, int c)
+{
+	size_t next;
+
+	if ((unsigned) c > 255)
+		return -1;
+
+	next = o->move[o->state * o->classes + o->class[c]];
+
+	if (o->color[next] < 0)
+		return -1;
+
+	o->state = next;
+	return o->color[next];
+}
+
+/*
+ * DFA image: header, color table and transition table. Offsets are
+ * relative to the image start, thus image is position-independent.
+ * Tables use host byte order, the order mark rejects foreign images.
+ */
+#define DFA_MAGIC	0x41464450	/* PDFA */
+#define DFA_VERSION	1
+#define DFA_ORDER	0x01020304
+
+struct dfa_image {
+	uint32_t magic, version, order, classes;
+	uint64_t count, start;
+	uint64_t color, move, size;	/* table offsets and image size */
+	unsigned char class[256];
+};
+
+static int dfa_write (int fd, const void *data, size_t size)
+{
+	const char *p = data;
+	ssize_t len;
+
+	for (; size > 0; p += len, size -= len)
+		if ((len = write (fd, p, size)) < 0) {
+			if (errno == EINTR) {
+				len = 0;
+				continue;
+			}
+
+			return 0;
+		}
+
+	return 1;
+}
+
+int nfa_dfa_save (const struct nfa_dfa *o, int fd)
+{
+	struct dfa_image h;
+
+	if (sizeof (o->color[0]) != 4 || sizeof (o->move[0]) != 4) {
+		errno = ENOTSUP;
+		return 0;
+	}
+
+	memset (&h, 0, sizeof (h));
+
+	h.magic   = DFA_MAGIC;
+	h.version = DFA_VERSION;
+	h.order   = DFA_ORDER;
+	h.classes = o->classes;
+	h.count   = o->count;
+	h.start   = o->start;
+	h.color   = sizeof (h);
+	h.move    = h.color + o->count * sizeof (o->color[0]);
+	h.size    = h.move  + o->count * o->classes * sizeof (o->move[0]);
+	memcpy (h.class, o->class, sizeof (h.class));
+
+	return dfa_write (fd, &h, sizeof (h)) &&
+	       dfa_write (fd, o->color, o->count * sizeof (o->color[0])) &&
+	       dfa_write (fd, o->move,
+			  o->count * o->classes * sizeof (o->move[0]));
+}
+
+/*
+ * The header is checked first, then every transition is checked to lead
+ * to a valid state with one linear pass over the transition table, thus
+ * matching with tables in place never reads out of bounds
+ */
+static int dfa_check (const struct dfa_image *h, size_t size)
+{
+	const uint32_t *move;
+	size_t i;
+
+	if (h->magic != DFA_MAGIC || h->version != DFA_VERSION ||
+	    h->order != DFA_ORDER)
+		return 0;
+
+	if (h->classes == 0 || h->classes > 256 || h->count < 2 ||
+	    h->start >= h->count || h->count > size / 4 ||
+	    h->color != sizeof (*h) ||
+	    h->move != h->color + h->count * 4 ||
+	    h->count * h->classes > size / 4 ||
+	    h->size != h->move + h->count * h->classes * 4 ||
+	    h->size != size)
+		return 0;
+
+	for (i = 0; i < 256; ++i)
+		if (h->class[i] >= h->classes)
+			return 0;
+
+	move = (const void *) ((const char *) h + h->move);
+
+	for (i = 0; i < h->count * h->classes; ++i)
+		if (move[i] >= h->count)
+			return 0;
+
+	return 1;
+}
+
+struct nfa_dfa *nfa_dfa_load (int fd)
+{
+	struct nfa_dfa *o;
+	struct stat st;
+	const struct dfa_image *h;
+	char *p;
+
+	if (sizeof (o->color[0]) != 4 || sizeof (o->move[0]) != 4) {
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	if (fstat (fd, &st) != 0)
+		return NULL;
+
+	if (st.st_size < (off_t) sizeof (*h) ||
+	    (uintmax_t) st.st_size > SIZE_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	o->size  = st.st_size;
+	o->image = mmap (NULL, o->size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (o->image == MAP_FAILED)
+		goto no_map;
+
+	h = o->image;
+
+	if (!dfa_check (h, o->size)) {
+		errno = EINVAL;
+		goto no_image;
+	}
+
+	p = o->image;
+
+	o->count   = h->count;
+	o->start   = o->state = h->start;
+	o->color   = (int *) (p + h->color);
+	o->move    = (unsigned *) (p + h->move);
+	o->classes = h->classes;
+	memcpy (o->class, h->class, sizeof (o->class));
+	return o;
+no_image:
+	munmap (o->image, o->size);
+no_map:
+	free (o);
+	return NULL;
+}
@@ -0,0 +1,205 @@
+/*
+ * Lexer Constructors Cross-Check
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <peruse/nfa-dfa.h>
+#include <peruse/nfa-lexer.h>
+#include <peruse/nfa-parse.h>
+
+static struct nfa_rule rules[] = {
+	{ rules + 1,	"if",			10 },
+	{ rules + 2,	"then",			11 },
+	{ rules + 3,	"else",			12 },
+
+	{ rules + 4,	"[ \t\n]+",		40 },
+	{ rules + 5,	"0|(1[01]*)",		41 },
+	{ NULL,		"[ab](-?[a-z0-9])*",	42 },
+};
+
+#define WINDOW_SIZE	16
+#define BATCH_SIZE	3
+
+struct corpus {
+	const char *data;
+	size_t size, pos, chunk;
+};
+
+static size_t corpus_read (void *to, size_t count, void *cookie)
+{
+	struct corpus *o = cookie;
+	size_t avail = o->size - o->pos;
+
+	if (o->chunk > 0 && count > o->chunk)
+		count = o->chunk;
+
+	if (count > avail)
+		count = avail;
+
+	memcpy (to, o->data + o->pos, count);
+	o->pos += count;
+	return count;
+}
+
+enum lexer_type {
+	LEXER_NFA, LEXER_DFA, LEXER_RULES, LEXER_BATCH, LEXER_WINDOW,
+	LEXER_MMAP, LEXER_TYPES,
+};
+
+static const char *type_name[LEXER_TYPES] = {
+	"nfa", "dfa", "rules", "batch", "window", "mmap",
+};
+
+static struct nfa_lexer *
+lexer_alloc (enum lexer_type type, struct corpus *c, FILE *file)
+{
+	struct nfa_state *nfa;
+	struct nfa_dfa *dfa;
+
+	if (type == LEXER_RULES)
+		return nfa_lexer_alloc_rules (rules, 0, corpus_read, c);
+
+	if ((nfa = nfa_parse_rules (rules)) == NULL)
+		return NULL;
+
+	switch (type) {
+	case LEXER_DFA:
+		if ((dfa = nfa_dfa_alloc (nfa)) == NULL)
+			return NULL;
+
+		return nfa_lexer_alloc_dfa (dfa, 0, corpus_read, c);
+	case LEXER_WINDOW:
+		c->chunk = 1;
+		return nfa_lexer_alloc (nfa, WINDOW_SIZE, corpus_read, c);
+	case LEXER_MMAP:
+		return nfa_lexer_alloc_mmap (nfa, fileno (file));
+	default:
+		return nfa_lexer_alloc (nfa, 0, corpus_read, c);
+	}
+}
+
+static void
+trace_token (FILE *to, const struct nfa_token *tok)
+{
+	fprintf (to, "%d: '%.*s'\n", tok->color, (int) tok->len, tok->text);
+}
+
+/*
+ * Writes token stream and the final lexer state into the trace
+ */
+static int
+trace (enum lexer_type type, const char *data, size_t size, FILE *file,
+       char **text, size_t *len)
+{
+	struct corpus c = { data, size, 0, 0 };
+	struct nfa_lexer *lex;
+	const struct nfa_token *tok;
+	struct nfa_token batch[BATCH_SIZE];
+	size_t n, i;
+	FILE *to;
+
+	if ((lex = lexer_alloc (type, &c, file)) == NULL)
+		return 0;
+
+	if ((to = open_memstream (text, len)) == NULL)
+		goto no_trace;
+
+	if (type == LEXER_BATCH)
+		while ((n = nfa_lexer_batch (lex, batch, BATCH_SIZE)) > 0)
+			for (i = 0; i < n; ++i)
+				trace_token (to, batch + i);
+	else
+		while ((tok = nfa_lexer (lex)) != NULL)
+			trace_token (to, tok);
+
+	fprintf (to, nfa_lexer_eof (lex) ? "eof\n" : "lexical error\n");
+	fclose (to);
+	nfa_lexer_free (lex);
+	return 1;
+no_trace:
+	nfa_lexer_free (lex);
+	return 0;
+}
+
+static char *read_all (FILE *from, size_t *size)
+{
+	char *data = NULL, *p;
+	size_t avail = 0, len;
+
+	for (*size = 0;; *size += len, avail -= len) {
+		if (avail == 0) {
+			avail = *size + 4096;
+
+			if ((p = realloc (data, *size + avail)) == NULL)
+				goto error;
+
+			data = p;
+		}
+
+		if ((len = fread (data + *size, 1, avail, from)) == 0)
+			break;
+	}
+
+	if (ferror (from))
+		goto error;
+
+	return data;
+error:
+	free (data);
+	return NULL;
+}
+
+/*
+ * Runs input from stdin through every lexer constructor, prints token
+ * stream of the reference NFA lexer and fails if any other lexer gives
+ * another stream
+ */
+int main (int argc, char *argv[])
+{
+	char *data, *ref, *text;
+	size_t size, ref_len, len;
+	FILE *file;
+	int type = LEXER_NFA, ok = 1;
+
+	if ((data = read_all (stdin, &size)) == NULL ||
+	    (file = tmpfile ()) == NULL ||
+	    fwrite (data, 1, size, file) != size || fflush (file) != 0) {
+		perror ("nfa-engines-test");
+		return 1;
+	}
+
+	if (!trace (LEXER_NFA, data, size, file, &ref, &ref_len))
+		goto no_lexer;
+
+	fwrite (ref, 1, ref_len, stdout);
+
+	for (type = LEXER_NFA + 1; type < LEXER_TYPES; ++type) {
+		if (!trace (type, data, size, file, &text, &len))
+			goto no_lexer;
+
+		if (len != ref_len || memcmp (text, ref, len) != 0) {
+			fprintf (stderr, "E: %s lexer token stream differs:\n",
+				 type_name[type]);
+			fwrite (text, 1, len, stderr);
+			ok = 0;
+		}
+
+		free (text);
+	}
+
+	free (ref);
+	fclose (file);
+	free (data);
+	return ok ? 0 : 1;
+no_lexer:
+	fprintf (stderr, "nfa-engines-test: cannot construct %s lexer\n",
+		 type_name[type]);
+	return 1;
+}
@@ -0,0 +1,187 @@
+/*
+ * Thompson NFA-based Lexer Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-lexer.h>
+#include <peruse/nfa-parse.h>
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(8 << 20)
+#define CHUNK_SIZE	512
+#define WINDOW_SIZE	(64 << 10)
+
+struct corpus {
+	char *data;
+	size_t size, pos;
+};
+
+static size_t corpus_read (void *to, size_t count, void *cookie)
+{
+	struct corpus *o = cookie;
+	size_t avail = o->size - o->pos;
+
+	if (count > CHUNK_SIZE)
+		count = CHUNK_SIZE;
+
+	if (count > avail)
+		count = avail;
+
+	memcpy (to, o->data + o->pos, count);
+	o->pos += count;
+	return count;
+}
+
+#define BATCH_SIZE	256
+
+static size_t scan (struct nfa_lexer *lex, int batch)
+{
+	struct nfa_token tokens[BATCH_SIZE];
+	size_t count = 0, n;
+
+	if (batch)
+		while ((n = nfa_lexer_batch (lex, tokens, BATCH_SIZE)) > 0)
+			count += n;
+	else
+		for (; nfa_lexer (lex) != NULL; ++count) {}
+
+	return count;
+}
+
+enum lexer_type {
+	LEXER_NFA, LEXER_BATCH, LEXER_DFA, LEXER_RULES,
+};
+
+struct lexer_case {
+	enum lexer_type type;
+	size_t len;		/* token length or number of rules */
+};
+
+static struct nfa_lexer *
+lexer_alloc (const struct nfa_rule *rules, enum lexer_type type,
+	     struct corpus *c)
+{
+	struct nfa_state *nfa;
+	struct nfa_dfa *dfa;
+
+	if (type == LEXER_RULES)
+		return nfa_lexer_alloc_rules (rules, WINDOW_SIZE, corpus_read, c);
+
+	if ((nfa = nfa_parse_rules (rules)) == NULL)
+		return NULL;
+
+	if (type != LEXER_DFA)
+		return nfa_lexer_alloc (nfa, WINDOW_SIZE, corpus_read, c);
+
+	if ((dfa = nfa_dfa_alloc (nfa)) == NULL)
+		return NULL;
+
+	return nfa_lexer_alloc_dfa (dfa, WINDOW_SIZE, corpus_read, c);
+}
+
+static int
+run (struct bench *o, const struct nfa_rule *rules, enum lexer_type type,
+     char *data)
+{
+	struct corpus c = { data, CORPUS_SIZE, 0 };
+	struct nfa_lexer *lex;
+	double start;
+	int ok;
+
+	if (data == NULL || (lex = lexer_alloc (rules, type, &c)) == NULL)
+		return 0;
+
+	start     = bench_now ();
+	o->tokens = scan (lex, type == LEXER_BATCH);
+	o->time   = bench_now () - start;
+	o->bytes  = c.size;
+
+	if (!(ok = nfa_lexer_eof (lex)))
+		fprintf (stderr, "E: lexical error at token %zu\n", o->tokens);
+
+	nfa_lexer_free (lex);
+	free (data);
+	return ok;
+}
+
+static int run_code (struct bench *o, const void *arg)
+{
+	const struct lexer_case *c = arg;
+
+	return run (o, bench_code_rules (), c->type, bench_code (CORPUS_SIZE));
+}
+
+static int run_long (struct bench *o, const void *arg)
+{
+	const struct lexer_case *c = arg;
+
+	return run (o, bench_long_rules (), c->type,
+		    bench_long (CORPUS_SIZE, c->len));
+}
+
+static int run_rules (struct bench *o, const void *arg)
+{
+	const struct lexer_case *c = arg;
+	struct nfa_rule *rules, space = { NULL, " +", 0 };
+	int ok;
+
+	if ((rules = bench_rules (c->len)) == NULL)
+		return 0;
+
+	rules[c->len - 1].next = &space;
+	space.color = c->len + 1;
+
+	ok = run (o, rules, c->type, bench_words (CORPUS_SIZE, c->len));
+	free (rules);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	static const char *type[] = { "nfa", "batch", "dfa", "rules" };
+	static const struct lexer_case code[] = {
+		{ LEXER_NFA }, { LEXER_BATCH }, { LEXER_DFA }, { LEXER_RULES },
+	};
+	static const struct lexer_case lens[] = {
+		{ LEXER_NFA,   8 },		{ LEXER_BATCH,   8 },
+		{ LEXER_NFA,  64 },		{ LEXER_BATCH,  64 },
+		{ LEXER_NFA,   1 << 10 },	{ LEXER_BATCH,   1 << 10 },
+		{ LEXER_NFA,  16 << 10 },	{ LEXER_BATCH,  16 << 10 },
+		{ LEXER_NFA, 256 << 10 },	{ LEXER_BATCH, 256 << 10 },
+	};
+	static const struct lexer_case rules[] = {
+		{ LEXER_NFA, 1000 }, { LEXER_RULES, 1000 },
+	};
+	const char *name = "nfa-lexer";
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (code) / sizeof (code[0]); ++i) {
+		snprintf (test, sizeof (test), "code-%s", type[code[i].type]);
+
+		if (!bench_run (name, test, run_code, code + i))
+			return 1;
+	}
+
+	for (i = 0; i < sizeof (lens) / sizeof (lens[0]); ++i) {
+		snprintf (test, sizeof (test), "long-%zu-%s", lens[i].len,
+			  type[lens[i].type]);
+
+		if (!bench_run (name, test, run_long, lens + i))
+			return 1;
+	}
+
+	for (i = 0; i < sizeof (rules) / sizeof (rules[0]); ++i) {
+		snprintf (test, sizeof (test), "rules-%zu-%s", rules[i].len,
+			  type[rules[i].type]);
+
+		if (!bench_run (name, test, run_rules, rules + i))
+			return 1;
+	}
+
+	return 0;
+}
@@ -6,7 +6,9 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <peruse/nfa-lexer.h>
 #include <peruse/nfa-parse.h>
@@ -26,6 +28,8 @@ int main (int argc, char *argv[])
 	struct nfa_state *set;
 	struct nfa_lexer *lex;
 	const struct nfa_token *tok;
+	struct nfa_lexer_stats stats;
+	int fd = -1;
 
 	if ((set = nfa_parse_rules (rules)) == NULL) {
 		fprintf (stderr, "nfa-lexer-test: cannot compile lexer\n");
@@ -35,7 +39,15 @@ int main (int argc, char *argv[])
 	fprintf (stderr, "I: Total number of NFA states in set = %zu\n",
 		 nfa_state_count (set));
 
-	if ((lex = nfa_lexer_alloc (set, 0, NULL, stdin)) == NULL) {
+	if (argc > 1 && (fd = open (argv[1], O_RDONLY)) < 0) {
+		perror ("nfa-lexer-test");
+		return 1;
+	}
+
+	lex = fd < 0 ? nfa_lexer_alloc (set, 0, NULL, stdin) :
+		       nfa_lexer_alloc_mmap (set, fd);
+
+	if (lex == NULL) {
 		fprintf (stderr, "nfa-lexer-test: cannot construct lexer\n");
 		return 1;
 	}
@@ -48,6 +60,20 @@ int main (int argc, char *argv[])
 		return 1;
 	}
 
+	if (nfa_lexer_stats (lex, &stats))
+		fprintf (stderr, "I: %zu tokens, %zu bytes, %zu restarts, "
+			 "%zu bytes read in %zu calls, %zu bytes moved\n",
+			 stats.tokens, stats.bytes, stats.restarts,
+			 stats.window.read, stats.window.reads,
+			 stats.window.moved);
+
+	fprintf (stderr, "I: Lexer memory footprint = %zu bytes\n",
+		 stats.memory);
+
 	nfa_lexer_free (lex);
+
+	if (fd >= 0)
+		close (fd);
+
 	return 0;
 }
@@ -10,46 +10,250 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <peruse/nfa-dfa.h>
 #include <peruse/nfa-lexer.h>
 #include <peruse/nfa-proc.h>
+#include <peruse/nfa-trie.h>
 #include <peruse/nfa-window.h>
 
+#include "nfa-perf.h"
+#include "nfa-proc.h"
+#include "nfa-stats.h"
+
 struct nfa_lexer {
 	struct nfa_window *in;
 	struct nfa_proc *proc;
+	struct nfa_dfa  *dfa;
+	struct nfa_trie *trie;	/* literal rules */
+	int *rule;		/* rule colors if engines report rule numbers */
+	int live;		/* engines alive in the current match */
 
 	struct nfa_token token;
+	size_t scan;		/* bytes of the token scanned already */
 	int eof;
+
+	size_t bytes, tokens, restarts;	/* statistics */
+	size_t *hits, colors;		/* tokens per color */
+
+	struct lexer_profile *prof;	/* rule profiles, if enabled */
 };
 
 /*
- * The NFA lexer constructor captures NFA, no one should try to use
- * the NFA passed to the constructor.
+ * Rule profiles are indexed by color, the step stamp of a rule is the
+ * number of the last step counted for the rule
  */
-struct nfa_lexer *nfa_lexer_alloc (struct nfa_state *start, size_t size,
-				   peruse_reader *read, void *cookie)
+struct lexer_profile {
+	struct nfa_rule_profile *rule;
+	size_t *stamp, colors;
+	size_t step;
+	int *owner;		/* rule color of processor states */
+};
+
+static void lexer_profile_free (struct lexer_profile *o)
+{
+	if (o == NULL)
+		return;
+
+	free (o->owner);
+	free (o->stamp);
+	free (o->rule);
+	free (o);
+}
+
+static int lexer_profile_grow (struct lexer_profile *o, size_t colors)
+{
+	struct nfa_rule_profile *rule;
+	size_t *stamp;
+
+	if (colors <= o->colors)
+		return 1;
+
+	if ((rule = realloc (o->rule, colors * sizeof (rule[0]))) == NULL)
+		return 0;
+
+	o->rule = rule;
+
+	if ((stamp = realloc (o->stamp, colors * sizeof (stamp[0]))) == NULL)
+		return 0;
+
+	o->stamp = stamp;
+
+	memset (rule  + o->colors, 0, (colors - o->colors) * sizeof (rule[0]));
+	memset (stamp + o->colors, 0, (colors - o->colors) * sizeof (stamp[0]));
+
+	o->colors = colors;
+	return 1;
+}
+
+/*
+ * The lexer context constructor captures the window
+ */
+static struct nfa_lexer *nfa_lexer_init (struct nfa_window *in)
 {
 	struct nfa_lexer *o;
 
-	if ((o = malloc (sizeof (*o))) == NULL)
+	if (in == NULL)
 		return NULL;
 
-	if ((o->in = nfa_window_alloc (size, read, cookie)) == NULL)
-		goto no_window;
+	if ((o = malloc (sizeof (*o))) == NULL)
+		goto no_lexer;
 
-	if ((o->proc = nfa_proc_alloc (start)) == NULL)
-		goto no_proc;
+	o->in   = in;
+	o->proc = NULL;
+	o->dfa  = NULL;
+	o->trie = NULL;
+	o->rule = NULL;
+	o->live = 0;
 
 	o->token.color = 0;
 	o->token.text = NULL;
 	o->token.len = 0;
+	o->scan = 0;
 	o->eof = 0;
 
+	o->bytes = o->tokens = o->restarts = 0;
+	o->hits = NULL;
+	o->colors = 0;
+	o->prof = NULL;
 	return o;
-no_proc:
-	nfa_window_free (o->in);
-no_window:
-	free (o);
+no_lexer:
+	nfa_window_free (in);
+	return NULL;
+}
+
+/*
+ * The NFA lexer constructor captures NFA, no one should try to use
+ * the NFA passed to the constructor.
+ */
+struct nfa_lexer *nfa_lexer_alloc (struct nfa_state *start, size_t size,
+				   peruse_reader *read, void *cookie)
+{
+	struct nfa_window *in = nfa_window_alloc (size, read, cookie);
+	struct nfa_lexer *o;
+
+	if ((o = nfa_lexer_init (in)) == NULL) {
+		nfa_state_free (start);
+		return NULL;
+	}
+
+	if ((o->proc = nfa_proc_alloc (start)) == NULL) {
+		nfa_lexer_free (o);
+		return NULL;
+	}
+
+	return o;
+}
+
+/*
+ * The mapped file lexer constructor captures NFA, no one should try to
+ * use the NFA passed to the constructor.
+ */
+struct nfa_lexer *nfa_lexer_alloc_mmap (struct nfa_state *start, int fd)
+{
+	struct nfa_window *in = nfa_window_alloc_mmap (fd);
+	struct nfa_lexer *o;
+
+	if ((o = nfa_lexer_init (in)) == NULL) {
+		nfa_state_free (start);
+		return NULL;
+	}
+
+	if ((o->proc = nfa_proc_alloc (start)) == NULL) {
+		nfa_lexer_free (o);
+		return NULL;
+	}
+
+	o->eof = 1;  /* whole file is in window already */
+	return o;
+}
+
+/*
+ * The DFA lexer constructor captures DFA, no one should try to use
+ * the DFA passed to the constructor.
+ */
+struct nfa_lexer *nfa_lexer_alloc_dfa (struct nfa_dfa *dfa, size_t size,
+				       peruse_reader *read, void *cookie)
+{
+	struct nfa_window *in = nfa_window_alloc (size, read, cookie);
+	struct nfa_lexer *o;
+
+	if ((o = nfa_lexer_init (in)) == NULL) {
+		nfa_dfa_free (dfa);
+		return NULL;
+	}
+
+	o->dfa = dfa;
+	return o;
+}
+
+/*
+ * The rules lexer matches plain literal rules with trie and the other
+ * rules with NFA processor. Both engines report rule numbers (starting
+ * from one) as colors, thus the rule priority is kept across engines.
+ */
+struct nfa_lexer *nfa_lexer_alloc_rules (const struct nfa_rule *rules,
+					 size_t size, peruse_reader *read,
+					 void *cookie)
+{
+	struct nfa_window *in = nfa_window_alloc (size, read, cookie);
+	struct nfa_lexer *o;
+	const struct nfa_rule *r;
+	struct nfa_rule *sub = NULL;
+	struct nfa_state *nfa = NULL;
+	size_t count, max, len, n;
+	char *text = NULL;
+	int i;
+
+	if ((o = nfa_lexer_init (in)) == NULL)
+		return NULL;
+
+	for (count = 0, max = 1, r = rules; r != NULL; r = r->next, ++count)
+		if ((len = strlen (r->re)) > max)
+			max = len;
+
+	if ((o->rule = malloc ((count + 1) * sizeof (o->rule[0]))) == NULL ||
+	    (o->trie = nfa_trie_alloc ()) == NULL ||
+	    (text = malloc (max)) == NULL ||
+	    (sub = malloc ((count + 1) * sizeof (sub[0]))) == NULL)
+		goto error;
+
+	/*
+	 * The other rules are united by the rules compiler, with rule
+	 * numbers as colors
+	 */
+	for (i = 1, n = 0, r = rules; r != NULL; r = r->next, ++i) {
+		o->rule[i] = r->color;
+
+		if ((len = nfa_parse_literal (r->re, text)) > 0) {
+			if (!nfa_trie_add (o->trie, text, len, i))
+				goto error;
+
+			continue;
+		}
+
+		sub[n].next  = sub + n + 1;
+		sub[n].re    = r->re;
+		sub[n].color = i;
+		++n;
+	}
+
+	if (n > 0)
+		sub[n - 1].next = NULL;
+
+	if (n > 0 && ((nfa = nfa_parse_rules (sub)) == NULL ||
+		      (o->proc = nfa_proc_alloc (nfa)) == NULL))
+		goto error;
+
+	if (nfa_trie_start (o->trie) < 0)  /* compile trie */
+		goto error;
+
+	free (sub);
+	free (text);
+	return o;
+error:
+	free (sub);
+	free (text);
+	nfa_lexer_free (o);
 	return NULL;
 }
 
@@ -58,7 +262,14 @@ void nfa_lexer_free (struct nfa_lexer *o)
 	if (o == NULL)
 		return;
 
-	nfa_proc_free (o->proc);
+	if (o->proc != NULL)
+		nfa_proc_free (o->proc);
+
+	nfa_trie_free (o->trie);
+	free (o->rule);
+	free (o->hits);
+	lexer_profile_free (o->prof);
+	nfa_dfa_free (o->dfa);
 	nfa_window_free (o->in);
 	free (o);
 }
@@ -77,39 +288,390 @@ const struct nfa_token *nfa_lexer_get (struct nfa_lexer *o)
 	return o->token.color == 0 ? NULL : &o->token;
 }
 
-const struct nfa_token *nfa_lexer (struct nfa_lexer *o)
+/*
+ * Returns color of the rule with lower number, or zero if no one rule
+ * matches
+ */
+static int nfa_lexer_rule (struct nfa_lexer *o, int a, int b)
+{
+	const int rule = a > 0 && (b <= 0 || a < b) ? a : b;
+
+	return rule > 0 ? o->rule[rule] : 0;
+}
+
+static int nfa_lexer_start (struct nfa_lexer *o)
+{
+	int a;
+
+	if (o->rule == NULL)
+		return o->dfa != NULL ? nfa_dfa_start (o->dfa) :
+					nfa_proc_start (o->proc);
+
+	a = nfa_trie_start (o->trie);
+
+	if (o->proc == NULL) {
+		o->live = 1;
+		return nfa_lexer_rule (o, a, 0);
+	}
+
+	o->live = 3;
+	return nfa_lexer_rule (o, a, nfa_proc_start (o->proc));
+}
+
+static int lexer_move (struct nfa_lexer *o, int c)
+{
+	int a = 0, b = 0;
+
+	if (o->rule == NULL)
+		return o->dfa != NULL ? nfa_dfa_step (o->dfa, c) :
+					nfa_proc_step (o->proc, c);
+
+	if ((o->live & 1) != 0 && (a = nfa_trie_step (o->trie, c)) < 0)
+		o->live &= ~1;
+
+	if ((o->live & 2) != 0 && (b = nfa_proc_step (o->proc, c)) < 0)
+		o->live &= ~2;
+
+	return o->live == 0 ? -1 : nfa_lexer_rule (o, a, b);
+}
+
+/*
+ * Counts active states of processor by rules: the rules engine reports
+ * no states if processor is dead already
+ */
+static void lexer_profile_step (struct nfa_lexer *o)
+{
+	struct lexer_profile *p = o->prof;
+	const uint32_t *set;
+	size_t count, i;
+	int color;
+
+	if (o->proc == NULL || (o->rule != NULL && (o->live & 2) == 0))
+		return;
+
+	set = nfa_proc_active (o->proc, &count);
+	++p->step;
+
+	for (i = 0; i < count; ++i) {
+		if ((color = p->owner[set[i]]) == 0)
+			continue;
+
+		if (p->stamp[color] != p->step) {
+			p->stamp[color] = p->step;
+			++p->rule[color].steps;
+		}
+
+		++p->rule[color].states;
+	}
+}
+
+static int nfa_lexer_step (struct nfa_lexer *o, int c)
+{
+	const int color = lexer_move (o, c);
+
+	if (o->prof != NULL && color >= 0)
+		lexer_profile_step (o);
+
+	return color;
+}
+
+/*
+ * Counts the token of the rule, the token is scanned for longest match
+ * up to the scan length
+ */
+static void
+lexer_profile_token (struct nfa_lexer *o, int color, size_t len, size_t scan)
+{
+	struct lexer_profile *p = o->prof;
+
+	if (color <= 0 || !lexer_profile_grow (p, (size_t) color + 1))
+		return;
+
+	++p->rule[color].tokens;
+	p->rule[color].bytes += len;
+	p->rule[color].waste += scan - len;
+}
+
+static const struct nfa_token *lexer_token (struct nfa_lexer *o, size_t scan)
+{
+	if (o->prof != NULL)
+		lexer_profile_token (o, o->token.color, o->token.len, scan);
+
+	return nfa_lexer_get (o);
+}
+
+/*
+ * Note that the processor state is kept across window refills: scanning
+ * continues from the first unread byte, and the token text pointer is
+ * updated since refill can move data in the window. The batch scanner
+ * can leave the token partially scanned in the same way.
+ */
+static const struct nfa_token *lexer_next (struct nfa_lexer *o)
 {
 	size_t i, avail;
 	const unsigned char *cursor;
 	int c, color;
 
-	nfa_window_release (o->in, o->token.len);
-start:
-	o->token.color = nfa_proc_start (o->proc);
-	o->token.len = 0;
+	if (o->scan == 0) {
+		nfa_window_release (o->in, o->token.len);
+
+		o->token.color = nfa_lexer_start (o);
+		o->token.len = 0;
+	}
+
+	for (i = o->scan, o->scan = 0;;) {
+		avail = SIZE_MAX;
+		cursor = nfa_window_request (o->in, &avail);
+		o->token.text = (void *) cursor;
+
+		while (i < avail) {
+			c = cursor[i++];
+
+			if ((color = nfa_lexer_step (o, c)) < 0)
+				return lexer_token (o, i);
+
+			if (color > 0) {
+				o->token.color = color;
+				o->token.len = i;
+			}
+		}
+
+		if (o->eof)
+			return lexer_token (o, i);
+
+		if (i > 0)
+			nfa_stats_inc (o->restarts);
+
+		if (!nfa_window_fill (o->in))
+			o->eof = 1;
+	}
+}
+
+/*
+ * Counts the token, the array of counts per color grows on demand
+ */
+static void lexer_account (struct nfa_lexer *o, int color, size_t len)
+{
+	const size_t colors = (size_t) color * 2 + 1;
+	size_t *hits;
+
+	++o->tokens;
+	o->bytes += len;
+
+	if ((size_t) color >= o->colors) {
+		if ((hits = realloc (o->hits, colors * sizeof (hits[0]))) == NULL)
+			return;
+
+		memset (hits + o->colors, 0,
+			(colors - o->colors) * sizeof (hits[0]));
+
+		o->hits   = hits;
+		o->colors = colors;
+	}
+
+	++o->hits[color];
+}
+
+const struct nfa_token *nfa_lexer (struct nfa_lexer *o)
+{
+	const struct nfa_token *t;
+
+	nfa_perf_enter (NFA_PERF_LEXER);
+	t = lexer_next (o);
+	nfa_perf_leave (NFA_PERF_LEXER);
+
+	if (NFA_STATS && t != NULL)
+		lexer_account (o, t->color, t->len);
+
+	return t;
+}
+
+/*
+ * Note that only the first token can require window refill, the rest of
+ * the batch is scanned within the window, thus refill never moves texts
+ * of returned tokens. Returned tokens are released immediately (release
+ * does not move data), except the last one if no token is left partially
+ * scanned: it is released by the next call as usual.
+ */
+size_t nfa_lexer_batch (struct nfa_lexer *o, struct nfa_token *tokens,
+			size_t max)
+{
+	const struct nfa_token *t;
+	size_t count, pos, i, avail, len;
+	const unsigned char *cursor;
+	int color, last;
+
+	if (max == 0 || (t = nfa_lexer (o)) == NULL)
+		return 0;
+
+	tokens[0] = *t;
+	pos = t->len;
 
 	avail = SIZE_MAX;
 	cursor = nfa_window_request (o->in, &avail);
 
-	for (i = 0; i < avail;) {
-		c = cursor[i++];
+	for (count = 1; count < max && pos < avail; ++count) {
+		last  = nfa_lexer_start (o);
+		len   = 0;
+		color = 0;
+
+		for (i = pos; i < avail;) {
+			if ((color = nfa_lexer_step (o, cursor[i++])) < 0)
+				break;
 
-		if ((color = nfa_proc_step (o->proc, c)) < 0)
-			return o->token.color == 0 ? NULL : &o->token;
+			if (color > 0) {
+				last = color;
+				len  = i - pos;
+			}
+		}
 
-		if (color > 0) {
-			o->token.color = color;
-			o->token.text = (void *) cursor;
-			o->token.len = i;
+		if (color >= 0 && !o->eof) {  /* incomplete token */
+			nfa_window_release (o->in, pos);
+			o->token.color = last;
+			o->token.text  = (void *) (cursor + pos);
+			o->token.len   = len;
+			o->scan        = i - pos;
+			return count;
 		}
+
+		if (last == 0)
+			break;  /* lexical error */
+
+		tokens[count].color = last;
+		tokens[count].text  = (void *) (cursor + pos);
+		tokens[count].len   = len;
+		pos += len;
+
+		if (NFA_STATS)
+			lexer_account (o, last, len);
+
+		if (o->prof != NULL)
+			lexer_profile_token (o, last, len, i - pos + len);
 	}
 
-	if (!o->eof) {
-		if (!nfa_window_fill (o->in))
-			o->eof = 1;
+	nfa_window_release (o->in, pos - tokens[count - 1].len);
+	o->token = tokens[count - 1];
+	return count;
+}
+
+int nfa_lexer_stats (const struct nfa_lexer *o, struct nfa_lexer_stats *s)
+{
+	s->bytes    = o->bytes;
+	s->tokens   = o->tokens;
+	s->color    = o->hits;
+	s->colors   = o->colors;
+	s->restarts = o->restarts;
 
-		goto start;
+	nfa_window_stats (o->in, &s->window);
+	s->memory = sizeof (*o) + s->window.size;
+
+	if (o->proc != NULL) {
+		nfa_proc_stats (o->proc, &s->proc);
+		s->memory += s->proc.memory;
 	}
+	else
+		memset (&s->proc, 0, sizeof (s->proc));
 
-	return nfa_lexer_get (o);
+	if (o->dfa != NULL)
+		s->memory += nfa_dfa_size (o->dfa);
+
+	return NFA_STATS;
+}
+
+/*
+ * Owners of processor states are colors of rules, or numbers of rules if
+ * the processor is a part of rules engine
+ */
+int nfa_lexer_profile (struct nfa_lexer *o)
+{
+	struct lexer_profile *p;
+	size_t count, i;
+	int max = 0;
+
+	if ((p = calloc (1, sizeof (*p))) == NULL)
+		return 0;
+
+	if (o->proc != NULL) {
+		if ((p->owner = nfa_proc_owners (o->proc, &count)) == NULL)
+			goto error;
+
+		for (i = 0; i < count; ++i) {
+			if (o->rule != NULL && p->owner[i] > 0)
+				p->owner[i] = o->rule[p->owner[i]];
+
+			if (p->owner[i] > max)
+				max = p->owner[i];
+		}
+	}
+
+	if (!lexer_profile_grow (p, (size_t) max + 1))
+		goto error;
+
+	lexer_profile_free (o->prof);
+	o->prof = p;
+	return 1;
+error:
+	lexer_profile_free (p);
+	return 0;
+}
+
+const struct nfa_rule_profile *
+nfa_lexer_profile_get (const struct nfa_lexer *o, size_t *count)
+{
+	if (o->prof == NULL)
+		return NULL;
+
+	*count = o->prof->colors;
+	return o->prof->rule;
+}
+
+/*
+ * The cost of rule is the number of active states it kept alive, then
+ * the number of bytes it scanned
+ */
+static int profile_cmp (const void *a, const void *b)
+{
+	const struct nfa_rule_profile *x = *(void **) a, *y = *(void **) b;
+
+	if (x->states != y->states)
+		return x->states > y->states ? -1 : 1;
+
+	if (x->bytes + x->waste != y->bytes + y->waste)
+		return x->bytes + x->waste > y->bytes + y->waste ? -1 : 1;
+
+	return x < y ? -1 : x > y;
+}
+
+void nfa_lexer_report (const struct nfa_lexer *o, FILE *to)
+{
+	const struct nfa_rule_profile *base, *p, **order;
+	size_t count, n, i;
+
+	if ((base = nfa_lexer_profile_get (o, &count)) == NULL ||
+	    (order = malloc (count * sizeof (order[0]))) == NULL)
+		return;
+
+	for (i = 0, n = 0; i < count; ++i)
+		if (base[i].tokens > 0 || base[i].steps > 0)
+			order[n++] = base + i;
+
+	qsort (order, n, sizeof (order[0]), profile_cmp);
+
+	fprintf (to, "%8s %10s %12s %8s %12s %8s %12s %8s\n",
+		 "color", "tokens", "bytes", "avg-len", "steps", "active",
+		 "waste", "waste/t");
+
+	for (i = 0; i < n; ++i) {
+		p = order[i];
+
+		fprintf (to, "%8zu %10zu %12zu %8.1f %12zu %8.1f %12zu %8.1f\n",
+			 (size_t) (p - base), p->tokens, p->bytes,
+			 p->tokens > 0 ? (double) p->bytes / p->tokens : 0.0,
+			 p->steps,
+			 p->steps > 0 ? (double) p->states / p->steps : 0.0,
+			 p->waste,
+			 p->tokens > 0 ? (double) p->waste / p->tokens : 0.0);
+	}
+
+	free (order);
 }
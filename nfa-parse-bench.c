@@ -0,0 +1,109 @@
+/*
+ * Regular Expression List Compiler Startup Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+#include "bench.h"
+
+/*
+ * Compiles rules into NFA (and lowers NFA into processor if requested)
+ * and releases it, the rules are counted as tokens
+ */
+static int
+run (struct bench *o, const struct nfa_rule *rules, size_t count, int proc)
+{
+	const struct nfa_rule *r;
+	struct nfa_state *nfa;
+	struct nfa_proc *p;
+	double start;
+
+	for (o->bytes = 0, r = rules; r != NULL; r = r->next)
+		o->bytes += strlen (r->re);
+
+	start = bench_now ();
+
+	if ((nfa = nfa_parse_rules (rules)) == NULL)
+		return 0;
+
+	if (!proc)
+		nfa_state_free (nfa);
+	else if ((p = nfa_proc_alloc (nfa)) == NULL)
+		return 0;
+	else
+		nfa_proc_free (p);
+
+	o->time   = bench_now () - start;
+	o->tokens = count;
+	return 1;
+}
+
+struct parse_case {
+	size_t count;
+	int proc;
+};
+
+static int run_rules (struct bench *o, const void *arg)
+{
+	const struct parse_case *c = arg;
+	struct nfa_rule *rules;
+	int ok;
+
+	if ((rules = bench_rules (c->count)) == NULL)
+		return 0;
+
+	ok = run (o, rules, c->count, c->proc);
+	free (rules);
+	return ok;
+}
+
+static int run_alt (struct bench *o, const void *arg)
+{
+	const struct parse_case *c = arg;
+	struct nfa_rule rule = { NULL, NULL, 1 };
+	int ok;
+
+	if ((rule.re = bench_alt_re (c->count)) == NULL)
+		return 0;
+
+	ok = run (o, &rule, 1, c->proc);
+	free (rule.re);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	static const struct parse_case rules[] = {
+		{ 1000, 0 }, { 10000, 0 }, { 100000, 0 },
+		{ 1000, 1 }, { 10000, 1 }, { 100000, 1 },
+	};
+	static const struct parse_case alt[] = {
+		{ 100000, 0 }, { 100000, 1 },
+	};
+	const char *name = "nfa-parse";
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (rules) / sizeof (rules[0]); ++i) {
+		snprintf (test, sizeof (test), "%s-rules-%zu",
+			  rules[i].proc ? "proc" : "parse", rules[i].count);
+
+		if (!bench_run (name, test, run_rules, rules + i))
+			return 1;
+	}
+
+	for (i = 0; i < sizeof (alt) / sizeof (alt[0]); ++i) {
+		snprintf (test, sizeof (test), "%s-alt-%zu",
+			  alt[i].proc ? "proc" : "parse", alt[i].count);
+
+		if (!bench_run (name, test, run_alt, alt + i))
+			return 1;
+	}
+
+	return 0;
+}
@@ -6,43 +6,231 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <limits.h>
-
-#include <peruse/nfa-parse.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "nfa-parse.h"
 #include "re-lexer.h"
 
-/* RE recursive descent parser */
+/* RE recursive descent parser, all states are allocated from one arena */
+
+struct re_parser {
+	struct re_lexer lex;
+	struct nfa_arena *arena;
+};
+
+/*
+ * Code point ranges are lowered into UTF-8 byte sequence ranges: the
+ * range is split until every piece is a sequence of byte ranges, then
+ * sequences are united via reversed trie, thus common suffixes (the
+ * continuation byte ranges) are shared.
+ */
+#define UTF8_MAX	4
+#define UTF8_SEQ_MAX	64
+
+struct utf8_seq {
+	int len;
+	unsigned char from[UTF8_MAX], to[UTF8_MAX];
+};
+
+struct utf8_split {
+	size_t count;
+	struct utf8_seq seq[UTF8_SEQ_MAX];
+};
+
+static int utf8_encode (int c, unsigned char *p)
+{
+	if (c < 0x80) {
+		p[0] = c;
+		return 1;
+	}
+
+	if (c < 0x800) {
+		p[0] = 0xc0 | (c >> 6);
+		p[1] = 0x80 | (c & 0x3f);
+		return 2;
+	}
+
+	if (c < 0x10000) {
+		p[0] = 0xe0 | (c >> 12);
+		p[1] = 0x80 | ((c >> 6) & 0x3f);
+		p[2] = 0x80 | (c & 0x3f);
+		return 3;
+	}
+
+	p[0] = 0xf0 | (c >> 18);
+	p[1] = 0x80 | ((c >> 12) & 0x3f);
+	p[2] = 0x80 | ((c >> 6) & 0x3f);
+	p[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+static int utf8_split (struct utf8_split *o, int lo, int hi)
+{
+	static const int max[] = { 0x7f, 0x7ff, 0xffff };
+	struct utf8_seq *s;
+	int i, m;
+
+	if (lo > hi)
+		return 1;
+
+	if (lo <= 0xdfff && hi >= 0xd800)  /* skip surrogates */
+		return (lo >= 0xd800 || utf8_split (o, lo, 0xd7ff)) &&
+		       (hi <= 0xdfff || utf8_split (o, 0xe000, hi));
+
+	for (i = 0; i < 3; ++i)
+		if (lo <= max[i] && max[i] < hi)
+			return utf8_split (o, lo, max[i]) &&
+			       utf8_split (o, max[i] + 1, hi);
+
+	for (i = 1; i < UTF8_MAX; ++i) {
+		m = (1 << (6 * i)) - 1;
+
+		if ((lo & ~m) == (hi & ~m))
+			continue;
+
+		if ((lo & m) != 0)
+			return utf8_split (o, lo, lo | m) &&
+			       utf8_split (o, (lo | m) + 1, hi);
+
+		if ((hi & m) != m)
+			return utf8_split (o, lo, (hi & ~m) - 1) &&
+			       utf8_split (o, hi & ~m, hi);
+	}
+
+	if (o->count == UTF8_SEQ_MAX) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	s = o->seq + o->count++;
+	s->len = utf8_encode (lo, s->from);
+	utf8_encode (hi, s->to);
+	return 1;
+}
+
+/*
+ * Orders sequences by byte ranges from the end, shorter sequence first
+ */
+static int utf8_cmp (const void *a, const void *b)
+{
+	const struct utf8_seq *x = a, *y = b;
+	int i, j;
+
+	for (i = x->len - 1, j = y->len - 1; i >= 0 && j >= 0; --i, --j) {
+		if (x->from[i] != y->from[j])
+			return x->from[i] < y->from[j] ? -1 : 1;
+
+		if (x->to[i] != y->to[j])
+			return x->to[i] < y->to[j] ? -1 : 1;
+	}
+
+	return x->len - y->len;
+}
 
-static struct nfa_state *re_char (struct re_lexer *o)
+/*
+ * Unites sequences with common suffix of the specified depth, the suffix
+ * itself is not included
+ */
+static struct nfa_state *
+utf8_build (struct re_parser *o, const struct utf8_seq *seq, size_t count,
+	    int depth)
+{
+	struct nfa_state *a = NULL, *b, *c;
+	size_t i, j, k;
+	int pos, from, to;
+
+	for (i = 0; i < count; i = j) {
+		pos  = seq[i].len - 1 - depth;
+		from = seq[i].from[pos];
+		to   = seq[i].to[pos];
+
+		for (
+			j = i + 1;
+			j < count && seq[j].from[seq[j].len - 1 - depth] == from &&
+				     seq[j].to  [seq[j].len - 1 - depth] == to;
+			++j
+		) {}
+
+		for (k = i; k < j && seq[k].len == depth + 1; ++k) {}
+
+		if ((b = nfa_arena_range (o->arena, from, to)) == NULL)
+			goto error;
+
+		if (k < j) {
+			if ((c = utf8_build (o, seq + k, j - k, depth + 1)) == NULL)
+				goto no_prefix;
+
+			if (k > i && (c = nfa_state_opt (c)) == NULL)
+				goto no_prefix;
+
+			if ((b = nfa_state_cat (c, b)) == NULL)
+				goto error;
+		}
+
+		if ((a = a == NULL ? b : nfa_state_union (a, b)) == NULL)
+			return NULL;
+	}
+
+	return a;
+no_prefix:
+	nfa_state_free (b);
+error:
+	nfa_state_free (a);
+	return NULL;
+}
+
+static struct nfa_state *re_utf8 (struct re_parser *o, int from, int to)
+{
+	struct utf8_split s;
+
+	if (from < 0 || to < 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (to < 0x80 || from > to)
+		return nfa_arena_range (o->arena, from, to);
+
+	s.count = 0;
+
+	if (!utf8_split (&s, from, to > 0x10ffff ? 0x10ffff : to))
+		return NULL;
+
+	qsort (s.seq, s.count, sizeof (s.seq[0]), utf8_cmp);
+	return utf8_build (o, s.seq, s.count, 0);
+}
+
+static struct nfa_state *re_char (struct re_parser *o)
 {
 	int c;
 
-	if ((c = re_lexer_next (o)) == '\0')
+	if ((c = re_lexer_next (&o->lex)) == '\0')
 		return NULL;
 
-	return nfa_state_atom (c);
+	return re_utf8 (o, c, c);
 }
 
-static struct nfa_state *re_range (struct re_lexer *o)
+static struct nfa_state *re_range (struct re_parser *o)
 {
 	int a, b;
 
-	if ((a = re_lexer_next (o)) == '\0')
+	if ((a = re_lexer_next (&o->lex)) == '\0')
 		return NULL;
 
-	if (re_lexer_peek (o) != '-')
-		return nfa_state_atom (a);
+	if (re_lexer_peek (&o->lex) != '-')
+		return re_utf8 (o, a, a);
 
-	re_lexer_next (o);
+	re_lexer_next (&o->lex);
 
-	if ((b = re_lexer_next (o)) == '\0')
+	if ((b = re_lexer_next (&o->lex)) == '\0')
 		return NULL;
 
-	return nfa_state_range (a, b);
+	return re_utf8 (o, a, b);
 }
 
-static struct nfa_state *re_set (struct re_lexer *o)
+static struct nfa_state *re_set (struct re_parser *o)
 {
 	int c;
 	struct nfa_state *a, *b;
@@ -50,11 +238,12 @@ static struct nfa_state *re_set (struct re_lexer *o)
 	if ((a = re_range (o)) == NULL)
 		return NULL;
 
-	while ((c = re_lexer_peek (o)) != ']' && c != '\0') {
+	while ((c = re_lexer_peek (&o->lex)) != ']' && c != '\0') {
 		if ((b = re_range (o)) == NULL)
 			goto error;
 
-		a = nfa_state_union (a, b);
+		if ((a = nfa_state_union (a, b)) == NULL)
+			return NULL;
 	}
 
 	return a;
@@ -63,42 +252,42 @@ error:
 	return NULL;
 }
 
-static struct nfa_state *re_exp (struct re_lexer *o);
+static struct nfa_state *re_exp (struct re_parser *o);
 
-static struct nfa_state *re_atom (struct re_lexer *o)
+static struct nfa_state *re_atom (struct re_parser *o)
 {
 	int c;
 	struct nfa_state *a;
 
-	if ((c = re_lexer_peek (o)) == '(') {
-		re_lexer_next (o);
+	if ((c = re_lexer_peek (&o->lex)) == '(') {
+		re_lexer_next (&o->lex);
 
 		if ((a = re_exp (o)) == NULL)
 			return NULL;
 
-		if (!re_lexer_eat (o, ')'))
+		if (!re_lexer_eat (&o->lex, ')'))
 			goto error;
 
 		return a;
 	}
 	else if (c == '[') {
-		re_lexer_next (o);
+		re_lexer_next (&o->lex);
 
 		if ((a = re_set (o)) == NULL)
 			return NULL;
 
-		if (!re_lexer_eat (o, ']'))
+		if (!re_lexer_eat (&o->lex, ']'))
 			goto error;
 
 		return a;
 	}
 	else if (c == '\\') {
-		re_lexer_next (o);
+		re_lexer_next (&o->lex);
 		return re_char (o);
 	}
 	else if (c == '.') {
-		re_lexer_next (o);
-		return nfa_state_range (0, INT_MAX);
+		re_lexer_next (&o->lex);
+		return re_utf8 (o, 0, 0x10ffff);
 	}
 
 	return re_char (o);
@@ -107,7 +296,7 @@ error:
 	return NULL;
 }
 
-static struct nfa_state *re_piece (struct re_lexer *o)
+static struct nfa_state *re_piece (struct re_parser *o)
 {
 	struct nfa_state *a;
 	int c;
@@ -115,18 +304,18 @@ static struct nfa_state *re_piece (struct re_lexer *o)
 	if ((a = re_atom (o)) == NULL)
 		return NULL;
 
-	while ((c = re_lexer_peek (o)) != '\0')
+	while (a != NULL && (c = re_lexer_peek (&o->lex)) != '\0')
 		switch (c) {
 		case '?':
-			re_lexer_next (o);
+			re_lexer_next (&o->lex);
 			a = nfa_state_opt (a);
 			break;
 		case '*':
-			re_lexer_next (o);
+			re_lexer_next (&o->lex);
 			a = nfa_state_star (a);
 			break;
 		case '+':
-			re_lexer_next (o);
+			re_lexer_next (&o->lex);
 			a = nfa_state_plus (a);
 			break;
 		default:
@@ -136,7 +325,7 @@ static struct nfa_state *re_piece (struct re_lexer *o)
 	return a;
 }
 
-static struct nfa_state *re_branch (struct re_lexer *o)
+static struct nfa_state *re_branch (struct re_parser *o)
 {
 	struct nfa_state *a, *b;
 	int c;
@@ -144,7 +333,7 @@ static struct nfa_state *re_branch (struct re_lexer *o)
 	if ((a = re_piece (o)) == NULL)
 		return NULL;
 
-	while ((c = re_lexer_peek (o)) != '\0' && c != ')' && c != '|') {
+	while ((c = re_lexer_peek (&o->lex)) != '\0' && c != ')' && c != '|') {
 		if ((b = re_piece (o)) == NULL)
 			goto error;
 
@@ -157,20 +346,21 @@ error:
 	return NULL;
 }
 
-static struct nfa_state *re_exp (struct re_lexer *o)
+static struct nfa_state *re_exp (struct re_parser *o)
 {
 	struct nfa_state *a, *b;
 
 	if ((a = re_branch (o)) == NULL)
 		return NULL;
 
-	while (re_lexer_peek (o) == '|') {
-		re_lexer_next (o);
+	while (re_lexer_peek (&o->lex) == '|') {
+		re_lexer_next (&o->lex);
 
 		if ((b = re_branch (o)) == NULL)
 			goto error;
 
-		a = nfa_state_union (a, b);
+		if ((a = nfa_state_union (a, b)) == NULL)
+			return NULL;
 	}
 
 	return a;
@@ -179,12 +369,14 @@ error:
 	return NULL;
 }
 
-struct nfa_state *nfa_parse_re (const char *re, int color)
+struct nfa_state *nfa_parse_re_arena (struct nfa_arena *arena,
+				      const char *re, int color)
 {
-	struct re_lexer o;
+	struct re_parser o;
 	struct nfa_state *start;
 
-	re_lexer_init (&o, re);
+	re_lexer_init (&o.lex, re);
+	o.arena = arena;
 
 	if ((start = re_exp (&o)) == NULL)
 		return NULL;
@@ -192,3 +384,49 @@ struct nfa_state *nfa_parse_re (const char *re, int color)
 	nfa_state_color (start, color);
 	return start;
 }
+
+/*
+ * A parse error releases the states parsed so far, and the arena itself
+ * is freed when the parser releases it
+ */
+struct nfa_state *nfa_parse_re (const char *re, int color)
+{
+	struct nfa_arena *arena;
+	struct nfa_state *start;
+
+	if ((arena = nfa_arena_alloc (strlen (re) + 1)) == NULL)
+		return NULL;
+
+	start = nfa_parse_re_arena (arena, re, color);
+	nfa_arena_free (arena);
+	return start;
+}
+
+/*
+ * Literal text is stored in UTF-8 as is, as the RE compiler matches it
+ */
+size_t nfa_parse_literal (const char *re, char *text)
+{
+	struct re_lexer o;
+	const char *p;
+	size_t len;
+	int c;
+
+	re_lexer_init (&o, re);
+
+	for (len = 0; (c = re_lexer_peek (&o)) != '\0'; len += o.p - p) {
+		if (c == '\\')
+			re_lexer_next (&o);
+		else if (strchr ("()[|.?*+", c) != NULL)
+			return 0;
+
+		p = o.p;
+
+		if ((c = re_lexer_next (&o)) <= 0)
+			return 0;  /* rejected by RE compiler */
+
+		memcpy (text + len, p, o.p - p);
+	}
+
+	return len;
+}
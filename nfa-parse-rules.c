@@ -6,22 +6,74 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <peruse/nfa-parse.h>
+#include <string.h>
 
+#include "nfa-parse.h"
+
+/*
+ * Rules are united into balanced tree: the stack holds unions of 2^k
+ * rules with decreasing k, as binary counter does, thus the left to right
+ * order of rules is kept.
+ */
+#define RULES_DEPTH	(sizeof (size_t) * 8 + 1)
+
+size_t nfa_parse_hint (const struct nfa_rule *rules)
+{
+	size_t hint;
+
+	for (hint = 1; rules != NULL; rules = rules->next)
+		hint += strlen (rules->re) + 1;
+
+	return hint;
+}
+
+/*
+ * All the rules share one arena, the arena is released by the last rule
+ * on error
+ */
 struct nfa_state *nfa_parse_rules (const struct nfa_rule *rules)
 {
-	struct nfa_state *nfa, *head = NULL;
+	struct nfa_state *stack[RULES_DEPTH], *nfa = NULL;
+	size_t size[RULES_DEPTH], top, i;
 	const struct nfa_rule *p;
+	struct nfa_arena *arena;
+
+	if ((arena = nfa_arena_alloc (nfa_parse_hint (rules))) == NULL)
+		return NULL;
 
-	for (p = rules; p != NULL; p = p->next) {
-		if ((nfa = nfa_parse_re (p->re, p->color)) == NULL)
+	for (top = 0, p = rules; p != NULL; p = p->next) {
+		if ((nfa = nfa_parse_re_arena (arena, p->re, p->color)) == NULL)
 			goto error;
 
-		head = head == NULL ? nfa : nfa_state_union (head, nfa);
+		stack[top] = nfa;
+		size[top++] = 1;
+
+		for (; top > 1 && size[top - 2] == size[top - 1]; --top) {
+			nfa = nfa_state_union (stack[top - 2], stack[top - 1]);
+
+			if (nfa == NULL) {
+				top -= 2;
+				goto error;
+			}
+
+			stack[top - 2] = nfa;
+			size[top - 2] *= 2;
+		}
 	}
 
-	return head;
+	if (top == 0)
+		goto error;
+
+	for (nfa = stack[--top]; top > 0;)
+		if ((nfa = nfa_state_union (stack[--top], nfa)) == NULL)
+			goto error;
+
+	nfa_arena_free (arena);
+	return nfa;
 error:
-	nfa_state_free (head);
+	for (i = 0; i < top; ++i)
+		nfa_state_free (stack[i]);
+
+	nfa_arena_free (arena);
 	return NULL;
 }
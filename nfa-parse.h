@@ -0,0 +1,29 @@
+/*
+ * Regular Expression to Thompson NFA compiler Internals
+ *
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_PARSE_INT_H
+#define PERUSE_NFA_PARSE_INT_H  1
+
+#include <peruse/nfa-parse.h>
+
+#include "nfa-state.h"
+
+/*
+ * The function nfa_parse_re_arena is the same as nfa_parse_re, but
+ * allocates states from the specified arena, thus all rules of a lexer
+ * can share one arena.
+ */
+struct nfa_state *nfa_parse_re_arena (struct nfa_arena *arena,
+				      const char *re, int color);
+
+/*
+ * Returns the arena hint for all the rules in the list
+ */
+size_t nfa_parse_hint (const struct nfa_rule *rules);
+
+#endif  /* PERUSE_NFA_PARSE_INT_H */
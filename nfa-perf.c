@@ -0,0 +1,214 @@
+/*
+ * Hardware Performance Counters for Matcher Hot Loops
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef PERUSE_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "nfa-perf.h"
+
+static const char *region_name[NFA_PERF_REGIONS] = {
+	"step", "lexer", "fill",
+};
+
+static const char *event_name[NFA_PERF_EVENTS] = {
+	"cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses",
+};
+
+const char *nfa_perf_region_name (enum nfa_perf_region region)
+{
+	return (unsigned) region < NFA_PERF_REGIONS ? region_name[region] :
+						      NULL;
+}
+
+const char *nfa_perf_event_name (enum nfa_perf_event event)
+{
+	return (unsigned) event < NFA_PERF_EVENTS ? event_name[event] : NULL;
+}
+
+#ifdef PERUSE_PERF
+
+static const struct perf_event {
+	uint32_t type;
+	uint64_t config;
+} events[NFA_PERF_EVENTS] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES		},
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS	},
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+			      PERF_COUNT_HW_CACHE_OP_READ << 8 |
+			      PERF_COUNT_HW_CACHE_RESULT_MISS << 16	},
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES	},
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES	},
+};
+
+/*
+ * All the events of a thread form one group, thus they are scheduled on
+ * PMU together and one read returns all the values
+ */
+struct perf_state {
+	int fd[NFA_PERF_EVENTS];	/* group leader first */
+	int event[NFA_PERF_EVENTS];	/* event of group member */
+	size_t count;			/* group members opened */
+	unsigned valid;
+	unsigned regions;		/* mask of regions to count */
+
+	int active[NFA_PERF_REGIONS];	/* region entered and sampled */
+	uint64_t start[NFA_PERF_REGIONS][NFA_PERF_EVENTS];
+	struct nfa_perf_count total[NFA_PERF_REGIONS];
+};
+
+static __thread struct perf_state perf;
+
+static int perf_event_open (const struct perf_event *e, int group)
+{
+	struct perf_event_attr a;
+
+	memset (&a, 0, sizeof (a));
+
+	a.size		 = sizeof (a);
+	a.type		 = e->type;
+	a.config	 = e->config;
+	a.disabled	 = group < 0;
+	a.exclude_kernel = 1;
+	a.exclude_hv	 = 1;
+	a.read_format	 = PERF_FORMAT_GROUP;
+
+	return syscall (SYS_perf_event_open, &a, 0, -1, group, 0);
+}
+
+static int perf_sample (uint64_t *value)
+{
+	uint64_t buf[1 + NFA_PERF_EVENTS];
+	const ssize_t size = sizeof (buf[0]) * (1 + perf.count);
+	size_t i;
+
+	if (read (perf.fd[0], buf, sizeof (buf)) < size)
+		return 0;
+
+	for (i = 0; i < perf.count; ++i)
+		value[perf.event[i]] = buf[1 + i];
+
+	return 1;
+}
+
+void nfa_perf_enter (enum nfa_perf_region region)
+{
+	if ((perf.regions & (1u << region)) == 0)
+		return;
+
+	perf.active[region] = perf_sample (perf.start[region]);
+}
+
+void nfa_perf_leave (enum nfa_perf_region region)
+{
+	struct nfa_perf_count *c = perf.total + region;
+	uint64_t value[NFA_PERF_EVENTS];
+	size_t i;
+
+	if (!perf.active[region] || !perf_sample (value))
+		return;
+
+	for (i = 0; i < perf.count; ++i)
+		c->value[perf.event[i]] += value[perf.event[i]] -
+					   perf.start[region][perf.event[i]];
+
+	++c->calls;
+	perf.active[region] = 0;
+}
+
+void nfa_perf_reset (void)
+{
+	size_t i;
+
+	for (i = 0; i < NFA_PERF_REGIONS; ++i) {
+		memset (perf.total + i, 0, sizeof (perf.total[i]));
+		perf.total[i].valid = perf.valid;
+		perf.active[i] = 0;
+	}
+}
+
+void nfa_perf_close (void)
+{
+	size_t i;
+
+	for (i = perf.count; i > 0; --i)
+		close (perf.fd[i - 1]);
+
+	perf.count   = 0;
+	perf.regions = 0;
+}
+
+int nfa_perf_open (unsigned regions)
+{
+	size_t i;
+	int fd;
+
+	nfa_perf_close ();
+	perf.valid = 0;
+
+	for (i = 0; i < NFA_PERF_EVENTS; ++i) {
+		fd = perf_event_open (events + i,
+				      perf.count > 0 ? perf.fd[0] : -1);
+		if (fd < 0)
+			continue;
+
+		perf.fd[perf.count] = fd;
+		perf.event[perf.count++] = i;
+		perf.valid |= 1u << i;
+	}
+
+	nfa_perf_reset ();
+
+	if (perf.count == 0)
+		return 0;
+
+	if (ioctl (perf.fd[0], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP) != 0 ||
+	    ioctl (perf.fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0)
+		goto error;
+
+	perf.regions = regions;
+	return 1;
+error:
+	nfa_perf_close ();
+	return 0;
+}
+
+int nfa_perf_read (enum nfa_perf_region region, struct nfa_perf_count *c)
+{
+	*c = perf.total[region];
+	return c->calls > 0;
+}
+
+#else  /* PERUSE_PERF not defined */
+
+int nfa_perf_open (unsigned regions)
+{
+	(void) regions;
+
+	errno = ENOSYS;
+	return 0;
+}
+
+void nfa_perf_close (void) {}
+void nfa_perf_reset (void) {}
+
+int nfa_perf_read (enum nfa_perf_region region, struct nfa_perf_count *c)
+{
+	(void) region;
+
+	memset (c, 0, sizeof (*c));
+	return 0;
+}
+
+#endif  /* PERUSE_PERF */
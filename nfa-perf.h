@@ -0,0 +1,30 @@
+/*
+ * Hardware Performance Counters Internals
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_PERF_INT_H
+#define PERUSE_NFA_PERF_INT_H  1
+
+#include <peruse/nfa-perf.h>
+
+/*
+ * Region hooks return at once if counters are not opened by the calling
+ * thread, and compile to nothing if PERUSE_PERF is not defined
+ */
+#ifdef PERUSE_PERF
+
+void nfa_perf_enter (enum nfa_perf_region region);
+void nfa_perf_leave (enum nfa_perf_region region);
+
+#else
+
+#define nfa_perf_enter(region)	((void) 0)
+#define nfa_perf_leave(region)	((void) 0)
+
+#endif
+
+#endif  /* PERUSE_NFA_PERF_INT_H */
@@ -0,0 +1,138 @@
+/*
+ * Thompson NFA Processor Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(8 << 20)
+
+/*
+ * Splits the corpus into the longest matches, returns the number of
+ * tokens, or zero on lexical error
+ */
+static size_t scan (struct nfa_proc *p, const char *data, size_t size)
+{
+	size_t pos, i, len, count;
+	int color;
+
+	for (pos = 0, count = 0; pos < size; pos += len, ++count) {
+		nfa_proc_start (p);
+
+		for (len = 0, i = pos; i < size;) {
+			if ((color = nfa_proc_step (p, (unsigned char) data[i++])) < 0)
+				break;
+
+			if (color > 0)
+				len = i - pos;
+		}
+
+		if (len == 0)
+			return 0;
+	}
+
+	return count;
+}
+
+static int run (struct bench *o, struct nfa_state *nfa, const char *data)
+{
+	struct nfa_proc *p;
+	double start;
+
+	if (nfa == NULL || data == NULL || (p = nfa_proc_alloc (nfa)) == NULL)
+		return 0;
+
+	start     = bench_now ();
+	o->tokens = scan (p, data, CORPUS_SIZE);
+	o->time   = bench_now () - start;
+	o->bytes  = CORPUS_SIZE;
+
+	nfa_proc_free (p);
+	return o->tokens > 0;
+}
+
+static int run_code (struct bench *o, const void *arg)
+{
+	return run (o, nfa_parse_rules (bench_code_rules ()),
+		    bench_code (CORPUS_SIZE));
+}
+
+static int run_long (struct bench *o, const void *arg)
+{
+	const size_t *len = arg;
+
+	return run (o, nfa_parse_rules (bench_long_rules ()),
+		    bench_long (CORPUS_SIZE, *len));
+}
+
+static int run_alt (struct bench *o, const void *arg)
+{
+	const size_t *k = arg;
+	struct nfa_rule rules[2] = {
+		{ rules + 1,	bench_alt_re (*k),	1 },
+		{ NULL,		"\n+",			2 },
+	};
+
+	if (rules[0].re == NULL)
+		return 0;
+
+	return run (o, nfa_parse_rules (rules),
+		    bench_alt (CORPUS_SIZE, 64, *k));
+}
+
+static int run_rules (struct bench *o, const void *arg)
+{
+	const size_t *count = arg;
+	struct nfa_rule *rules, space = { NULL, " +", 0 };
+
+	if ((rules = bench_rules (*count)) == NULL)
+		return 0;
+
+	rules[*count - 1].next = &space;
+	space.color = *count + 1;
+
+	return run (o, nfa_parse_rules (rules),
+		    bench_words (CORPUS_SIZE, *count));
+}
+
+int main (int argc, char *argv[])
+{
+	static const size_t len[]   = { 8, 64, 4 << 10 };
+	static const size_t k[]     = { 4, 12 };
+	static const size_t count[] = { 100, 1000 };
+	const char *name = "nfa-proc";
+	char test[32];
+	size_t i;
+
+	if (!bench_run (name, "code", run_code, NULL))
+		return 1;
+
+	for (i = 0; i < sizeof (len) / sizeof (len[0]); ++i) {
+		snprintf (test, sizeof (test), "long-%zu", len[i]);
+
+		if (!bench_run (name, test, run_long, len + i))
+			return 1;
+	}
+
+	for (i = 0; i < sizeof (k) / sizeof (k[0]); ++i) {
+		snprintf (test, sizeof (test), "alt-%zu", k[i]);
+
+		if (!bench_run (name, test, run_alt, k + i))
+			return 1;
+	}
+
+	for (i = 0; i < sizeof (count) / sizeof (count[0]); ++i) {
+		snprintf (test, sizeof (test), "rules-%zu", count[i]);
+
+		if (!bench_run (name, test, run_rules, count + i))
+			return 1;
+	}
+
+	return 0;
+}
@@ -16,7 +16,7 @@ static int nfa_proc_match (struct nfa_proc *o, const char *s)
 	int state = nfa_proc_start (o);
 
 	for (; *s != '\0'; ++s)
-		if ((state = nfa_proc_step (o, *s)) < 0)
+		if ((state = nfa_proc_step (o, (unsigned char) *s)) < 0)
 			return 0;
 
 	return state > 0;
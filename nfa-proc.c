@@ -6,87 +6,686 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
-#include <limits.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include <peruse/bitset.h>
-#include <peruse/nfa-proc.h>
-
+#include "nfa-perf.h"
+#include "nfa-proc.h"
+#include "nfa-skip.h"
 #include "nfa-state.h"
+#include "nfa-stats.h"
 
-struct nfa_proc {
-	struct nfa_state *start;
+#define NFA_DFA_LIMIT	(1 << 20)	/* default DFA cache size, bytes */
+#define NFA_DFA_RATIO	10		/* minimum bytes per cached state */
+#define NFA_DFA_MISSES	3		/* inefficient flushes to give up */
+#define NFA_BITS	64		/* maximum states for bit-parallel */
+
+/*
+ * Sparse set of state indexes (Briggs and Torczon): clear, insertion and
+ * membership test take constant time, iteration goes in insertion order
+ */
+struct nfa_sset {
 	size_t count;
-	const struct nfa_state **map;
-	long *cset, *nset;
+	uint32_t *dense, *sparse;
 };
 
+static int sset_init (struct nfa_sset *o, size_t limit)
+{
+	o->count  = 0;
+	o->dense  = malloc (limit * sizeof (o->dense[0]));
+	o->sparse = calloc (limit,  sizeof (o->sparse[0]));
+
+	return o->dense != NULL && o->sparse != NULL;
+}
+
+static void sset_fini (struct nfa_sset *o)
+{
+	free (o->sparse);
+	free (o->dense);
+}
+
+static void sset_clear (struct nfa_sset *o)
+{
+	o->count = 0;
+}
+
+static void sset_add (struct nfa_sset *o, uint32_t x)
+{
+	const uint32_t i = o->sparse[x];
+
+	if (i < o->count && o->dense[i] == x)
+		return;
+
+	o->sparse[x] = o->count;
+	o->dense[o->count++] = x;
+}
+
 /*
- * The NFA processor constructor captures NFA, no one should try to use
- * the NFA passed to the constructor.
+ * Lazy DFA state: a set of NFA states with cached transitions for every
+ * byte class, the ordered list of NFA states is stored after transitions
  */
-struct nfa_proc *nfa_proc_alloc (struct nfa_state *nfa)
+struct nfa_dstate {
+	int color;	/* match color of transition into this state */
+	size_t hash, count;
+	struct nfa_dstate *chain;	/* hash table chain */
+	struct nfa_dstate *move[];	/* NULL if not computed yet */
+};
+
+static struct nfa_dstate dfa_dead = { .color = -1 };
+
+/*
+ * Flat NFA program: consuming states only, split states are removed and
+ * replaced by closure lists. The entry with index equal to the number of
+ * states describes start state closure.
+ */
+struct nfa_range {
+	int from, to;	/* state consumes bytes in range [from, to] */
+};
+
+struct nfa_proc {
+	const struct nfa_proc *base;	/* owner of shared program, or NULL */
+	size_t count;		/* number of states */
+	struct nfa_range *range;
+	uint32_t *first, *list;	/* closure list ranges and closure lists */
+	int *accept;		/* color if stop state reachable, or zero */
+	struct nfa_sset cset, nset;
+	uint32_t *key;		/* ordered copy of set to intern */
+
+	size_t classes;		/* number of byte classes */
+	unsigned char class[256];	/* byte to class map */
+	struct nfa_skip skip;	/* prefilter for search */
+
+	/* bit-parallel program, used if bits is not NULL */
+	struct nfa_bits *bits;
+	uint64_t active;	/* active positions */
+
+	/* lazy DFA, used if state is not NULL */
+	struct nfa_dstate *state, *init, **table;
+	size_t order, total;	/* table size order, number of states */
+	size_t limit, used;	/* cache size limit and usage, bytes */
+	size_t bytes, flushes;	/* bytes processed since last flush */
+	int misses;		/* number of inefficient flushes in a row */
+
+	struct nfa_proc_stats stats;
+};
+
+static uint32_t *dfa_set (const struct nfa_proc *o, struct nfa_dstate *p)
 {
-	struct nfa_proc *o;
-	const struct nfa_state *p;
+	return (void *) (p->move + o->classes);
+}
+
+static void dfa_clear (struct nfa_proc *o)
+{
+	const size_t size = (size_t) 1 << o->order;
+	struct nfa_dstate *p, *next;
 	size_t i;
 
-	if ((o = malloc (sizeof (*o))) == NULL)
-		goto no_obj;
+	if (o->table == NULL)
+		return;
 
-	nfa_state_order (nfa);
+	for (i = 0; i < size; ++i)
+		for (p = o->table[i]; p != NULL; p = next) {
+			next = p->chain;
+			free (p);
+		}
 
-	o->start = nfa;
-	o->count = nfa_state_count (nfa);
+	memset (o->table, 0, size * sizeof (o->table[0]));
 
-	if ((o->map = malloc (o->count * sizeof (o->map[0]))) == NULL)
-		goto no_map;
+	o->state = o->init = NULL;
+	o->total = 0;
+	o->used  = size * sizeof (o->table[0]);
+	o->bytes = 0;
+	++o->flushes;
+}
+
+static int dfa_usable (const struct nfa_proc *o)
+{
+	return o->limit > 0 && o->misses < NFA_DFA_MISSES;
+}
+
+/*
+ * Drop all cached states. If the cache was used inefficiently several
+ * times in a row it is disabled: returns zero in this case.
+ */
+static int dfa_flush (struct nfa_proc *o)
+{
+	if (o->bytes < o->total * NFA_DFA_RATIO)
+		++o->misses;
+	else
+		o->misses = 0;
+
+	dfa_clear (o);
+	return dfa_usable (o);
+}
+
+static int dfa_grow (struct nfa_proc *o)
+{
+	const size_t order = o->table == NULL ? 6 : o->order + 1;
+	const size_t size = (size_t) 1 << order;
+	struct nfa_dstate **table, *p, *next;
+	size_t i;
+
+	if ((table = calloc (size, sizeof (table[0]))) == NULL)
+		return 0;
+
+	for (i = 0; o->table != NULL && i < ((size_t) 1 << o->order); ++i)
+		for (p = o->table[i]; p != NULL; p = next) {
+			next = p->chain;
+			p->chain = table[p->hash & (size - 1)];
+			table[p->hash & (size - 1)] = p;
+		}
+
+	o->used += (size - (o->table == NULL ? 0 : size / 2)) *
+		   sizeof (table[0]);
+
+	free (o->table);
+	o->table = table;
+	o->order = order;
+	return 1;
+}
+
+static size_t dfa_hash (const uint32_t *set, size_t count, int color)
+{
+	size_t i, hash = color;
 
-	for (p = o->start, i = 0; p != NULL; p = p->next, ++i)
-		o->map[i] = p;
+	for (i = 0; i < count; ++i)
+		hash = (hash ^ set[i]) * 16777619;
 
-	if ((o->cset = bitset_alloc (o->count)) == NULL)
+	return hash;
+}
+
+static int index_cmp (const void *a, const void *b)
+{
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Returns DFA state for the set of NFA states, or NULL on allocation
+ * error or if cache is thrashing. Note that cache flush invalidates all
+ * previously returned states.
+ */
+static struct nfa_dstate *dfa_intern (struct nfa_proc *o,
+				      const struct nfa_sset *set, int color)
+{
+	const size_t size = set->count * sizeof (set->dense[0]);
+	const size_t row  = o->classes * sizeof (struct nfa_dstate *);
+	struct nfa_dstate *p;
+	size_t hash, i;
+
+	memcpy (o->key, set->dense, size);
+	qsort (o->key, set->count, sizeof (o->key[0]), index_cmp);
+
+	hash = dfa_hash (o->key, set->count, color);
+
+	if (o->table == NULL && !dfa_grow (o))
+		return NULL;
+
+	for (
+		p = o->table[hash & (((size_t) 1 << o->order) - 1)];
+		p != NULL;
+		p = p->chain
+	)
+		if (p->hash == hash && p->color == color &&
+		    p->count == set->count &&
+		    memcmp (dfa_set (o, p), o->key, size) == 0)
+			return p;
+
+	if (o->used + sizeof (*p) + row + size > o->limit && !dfa_flush (o))
+		return NULL;
+
+	if (o->total >= ((size_t) 1 << o->order))
+		dfa_grow (o);  /* it is ok to use longer chains on failure */
+
+	if ((p = malloc (sizeof (*p) + row + size)) == NULL)
+		return NULL;
+
+	p->color = color;
+	p->hash  = hash;
+	p->count = set->count;
+
+	i = hash & (((size_t) 1 << o->order) - 1);
+	p->chain = o->table[i];
+	o->table[i] = p;
+
+	memset (p->move, 0, row);
+	memcpy (dfa_set (o, p), o->key, size);
+
+	o->used += sizeof (*p) + row + size;
+	++o->total;
+	return p;
+}
+
+/*
+ * Allocates private simulation state of processor: state sets and empty
+ * lazy DFA cache
+ */
+static int proc_init (struct nfa_proc *o)
+{
+	if (!sset_init (&o->cset, o->count))
 		goto no_cset;
 
-	if ((o->nset = bitset_alloc (o->count)) == NULL)
+	if (!sset_init (&o->nset, o->count) ||
+	    (o->key = malloc (o->count * sizeof (o->key[0]))) == NULL)
 		goto no_nset;
 
-	return o;
+	o->state = o->init = NULL;
+	o->table = NULL;
+	o->order = o->total = 0;
+	o->used  = o->bytes = o->flushes = 0;
+	o->misses = 0;
+	o->active = 0;
+
+	memset (&o->stats, 0, sizeof (o->stats));
+	return 1;
 no_nset:
-	bitset_free (o->cset);
+	sset_fini (&o->nset);
 no_cset:
-	free (o->map);
-no_map:
+	sset_fini (&o->cset);
+	return 0;
+}
+
+/*
+ * Lowers NFA closures into flat program: states are renumbered skipping
+ * split states, the order of states is kept
+ */
+static int proc_lower (struct nfa_proc *o, const struct nfa_closure *c,
+		       const struct nfa_state **map, size_t total)
+{
+	uint32_t *index, k, len;
+	size_t i, j;
+
+	for (i = 0, o->count = 0; i < total; ++i)
+		if (map[i]->from != NFA_SPLIT)
+			++o->count;
+
+	if (o->count >= UINT32_MAX || c->first[total + 1] >= UINT32_MAX) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	if ((index = malloc (total * sizeof (index[0]))) == NULL)
+		return 0;
+
+	o->range  = malloc (o->count * sizeof (o->range[0]));
+	o->first  = malloc ((o->count + 2) * sizeof (o->first[0]));
+	o->list   = malloc ((c->first[total + 1] + 1) * sizeof (o->list[0]));
+	o->accept = malloc ((o->count + 1) * sizeof (o->accept[0]));
+
+	if (o->range == NULL || o->first == NULL || o->list == NULL ||
+	    o->accept == NULL)
+		goto error;
+
+	for (i = 0, k = 0; i < total; ++i)
+		if (map[i]->from != NFA_SPLIT)
+			index[i] = k++;
+
+	for (i = 0, k = 0, len = 0; i <= total; ++i) {
+		if (i < total && map[i]->from == NFA_SPLIT)
+			continue;
+
+		if (i < total) {
+			o->range[k].from = map[i]->from;
+			o->range[k].to   = map[i]->to;
+		}
+
+		o->first[k]  = len;
+		o->accept[k] = c->accept[i];
+
+		for (j = c->first[i]; j < c->first[i + 1]; ++j)
+			o->list[len++] = index[c->list[j]];
+
+		++k;
+	}
+
+	o->first[k] = len;
+	free (index);
+	return 1;
+error:
+	free (o->accept);
+	free (o->list);
+	free (o->first);
+	free (o->range);
+	free (index);
+	return 0;
+}
+
+static void proc_fini (struct nfa_proc *o)
+{
+	free (o->bits);
+	free (o->accept);
+	free (o->list);
+	free (o->first);
+	free (o->range);
+}
+
+/*
+ * Bit-parallel program: the flat program is a position (Glushkov)
+ * automaton, thus up to 64 positions are kept as bits of a word. A step
+ * takes positions which accept the byte and unites their follow sets
+ * looked up by 8-bit chunks. It replaces NFA simulation if lazy DFA is
+ * not used: a warm DFA cache takes one lookup per byte and stays faster.
+ *
+ * Bits are ordered by rules: the color of the lowest accepting bit is
+ * the color of the rule added first, as for state sets.
+ */
+struct nfa_bits {
+	size_t chunks;		/* 8-bit chunks of position mask */
+	uint64_t start, final;	/* start closure and accepting positions */
+	uint64_t *mask;		/* positions which accept byte class */
+	uint64_t *follow;	/* follow sets of chunk values */
+	uint32_t index[NFA_BITS];	/* state of position */
+	unsigned char bit[NFA_BITS];	/* position of state */
+	int color[NFA_BITS];		/* accept color of position */
+	uint64_t table[];
+};
+
+static size_t bits_size (const struct nfa_proc *o)
+{
+	return sizeof (*o->bits) +
+	       (o->classes + o->bits->chunks * 256) * sizeof (uint64_t);
+}
+
+/*
+ * States connected by closure lists belong to the same rule, rules come
+ * in the start closure in order, thus the order of the first appearance
+ * of a component there is the rule order. Returns rank of component per
+ * state, unreachable states are ranked last.
+ */
+static void bits_rank (const struct nfa_proc *o, size_t *rank)
+{
+	size_t comp[NFA_BITS], i, j, k, next;
+	int changed;
+
+	for (i = 0; i < o->count; ++i)
+		comp[i] = i;
+
+	do {
+		for (i = 0, changed = 0; i < o->count; ++i)
+			for (j = o->first[i]; j < o->first[i + 1]; ++j) {
+				k = o->list[j];
+
+				if (comp[k] != comp[i]) {
+					comp[i] = comp[k] = comp[i] < comp[k] ?
+							    comp[i] : comp[k];
+					changed = 1;
+				}
+			}
+	}
+	while (changed);
+
+	for (i = 0; i < o->count; ++i)
+		rank[i] = NFA_BITS;
+
+	for (j = o->first[o->count], next = 0; j < o->first[o->count + 1]; ++j)
+		if (rank[comp[o->list[j]]] == NFA_BITS)
+			rank[comp[o->list[j]]] = next++;
+
+	for (i = 0; i < o->count; ++i)
+		comp[i] = rank[comp[i]];
+
+	memcpy (rank, comp, o->count * sizeof (rank[0]));
+}
+
+static uint64_t bits_closure (const struct nfa_proc *o, const size_t *bit,
+			      size_t index)
+{
+	uint64_t set = 0;
+	uint32_t j;
+
+	for (j = o->first[index]; j < o->first[index + 1]; ++j)
+		set |= (uint64_t) 1 << bit[o->list[j]];
+
+	return set;
+}
+
+static struct nfa_bits *bits_alloc (const struct nfa_proc *o)
+{
+	const size_t chunks = (o->count + 7) / 8;
+	size_t rank[NFA_BITS], bit[NFA_BITS], i, j;
+	uint64_t follow[NFA_BITS], *t;
+	struct nfa_bits *b;
+	int c;
+
+	b = malloc (sizeof (*b) + (o->classes + chunks * 256) * sizeof (t[0]));
+	if (b == NULL)
+		return NULL;
+
+	b->chunks = chunks;
+	b->mask   = b->table;
+	b->follow = b->table + o->classes;
+
+	bits_rank (o, rank);
+
+	for (i = 0; i < o->count; ++i) {  /* stable sort by rank */
+		for (j = i; j > 0 && rank[b->index[j - 1]] > rank[i]; --j)
+			b->index[j] = b->index[j - 1];
+
+		b->index[j] = i;
+	}
+
+	for (i = 0; i < o->count; ++i)
+		b->bit[b->index[i]] = bit[b->index[i]] = i;
+
+	memset (b->mask, 0, o->classes * sizeof (b->mask[0]));
+	b->final = 0;
+
+	for (i = 0; i < o->count; ++i) {
+		const struct nfa_range *r = o->range + b->index[i];
+
+		for (c = r->from < 0 ? 0 : r->from; c <= r->to && c < 256; ++c)
+			b->mask[o->class[c]] |= (uint64_t) 1 << i;
+
+		follow[i]   = bits_closure (o, bit, b->index[i]);
+		b->color[i] = o->accept[b->index[i]];
+
+		if (b->color[i] != 0)
+			b->final |= (uint64_t) 1 << i;
+	}
+
+	b->start = bits_closure (o, bit, o->count);
+
+	for (i = 0, t = b->follow; i < chunks; ++i, t += 256)
+		for (t[0] = 0, j = 1; j < 256; ++j)
+			t[j] = t[j & (j - 1)] |
+			       (8 * i + __builtin_ctz (j) < o->count ?
+				follow[8 * i + __builtin_ctz (j)] : 0);
+
+	return b;
+}
+
+/*
+ * Converts the set of states into active positions
+ */
+static void bits_load (struct nfa_proc *o, const struct nfa_sset *set)
+{
+	size_t i;
+
+	for (o->active = 0, i = 0; i < set->count; ++i)
+		o->active |= (uint64_t) 1 << o->bits->bit[set->dense[i]];
+}
+
+/*
+ * returns -1 on error (no match), node color on match, zero otherwise
+ */
+static int bits_step (struct nfa_proc *o, int c)
+{
+	const struct nfa_bits *b = o->bits;
+	const uint64_t *t = b->follow;
+	uint64_t m, set, next = 0;
+	size_t i;
+
+	if ((unsigned) c < 256)
+		m = o->active & b->mask[o->class[c]];
+	else
+		for (m = 0, set = o->active; set != 0; set &= set - 1) {
+			i = __builtin_ctzll (set);
+
+			if (o->range[b->index[i]].from <= c &&
+			    c <= o->range[b->index[i]].to)
+				m |= (uint64_t) 1 << i;
+		}
+
+	if (m == 0)
+		return -1;
+
+	for (set = m; set != 0; set >>= 8, t += 256)
+		next |= t[set & 0xff];
+
+	o->active = next;
+
+	return (m &= b->final) == 0 ? 0 : b->color[__builtin_ctzll (m)];
+}
+
+/*
+ * Computes byte classes, prefix and flat program of NFA
+ */
+static int proc_compile (struct nfa_proc *o, struct nfa_state *nfa)
+{
+	const size_t total = nfa_state_count (nfa);
+	const struct nfa_state **map, *p;
+	struct nfa_closure c;
+	struct nfa_prefix prefix;
+	size_t i;
+	int ok = 0;
+
+	nfa_state_order (nfa);
+	o->classes = nfa_state_classes (nfa, o->class);
+
+	if ((map = malloc (total * sizeof (map[0]))) == NULL)
+		return 0;
+
+	for (p = nfa, i = 0; p != NULL; p = p->next, ++i)
+		map[i] = p;
+
+	if (!nfa_closure_init (&c, nfa, total))
+		goto no_closure;
+
+	if (!nfa_closure_prefix (&c, map, total, &prefix) ||
+	    !proc_lower (o, &c, map, total))
+		goto no_prog;
+
+	nfa_skip_init (&o->skip, &prefix);
+	o->bits = o->count <= NFA_BITS ? bits_alloc (o) : NULL;
+	ok = 1;
+no_prog:
+	nfa_closure_fini (&c);
+no_closure:
+	free (map);
+	return ok;
+}
+
+/*
+ * The NFA processor constructor captures NFA, no one should try to use
+ * the NFA passed to the constructor. NFA is lowered into flat program and
+ * freed.
+ */
+struct nfa_proc *nfa_proc_alloc (struct nfa_state *nfa)
+{
+	struct nfa_proc *o;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		goto no_obj;
+
+	o->base = NULL;
+
+	if (!proc_compile (o, nfa))
+		goto no_prog;
+
+	if (!proc_init (o))
+		goto no_state;
+
+	o->limit = NFA_DFA_LIMIT;
+	nfa_state_free (nfa);
+	return o;
+no_state:
+	proc_fini (o);
+no_prog:
 	free (o);
 no_obj:
 	nfa_state_free (nfa);
 	return NULL;
 }
 
+/*
+ * The clone shares NFA with the base processor, only simulation state
+ * and DFA cache are private, thus clones can be used in parallel.
+ */
+struct nfa_proc *nfa_proc_clone (const struct nfa_proc *base)
+{
+	struct nfa_proc *o;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	*o = *base;
+	o->base = base->base != NULL ? base->base : base;
+
+	if (!proc_init (o)) {
+		free (o);
+		return NULL;
+	}
+
+	return o;
+}
+
 void nfa_proc_free (struct nfa_proc *o)
 {
-	bitset_free (o->nset);
-	bitset_free (o->cset);
-	free (o->map);
-	nfa_state_free (o->start);
+	dfa_clear (o);
+	free (o->table);
+	free (o->key);
+	sset_fini (&o->nset);
+	sset_fini (&o->cset);
+
+	if (o->base == NULL)
+		proc_fini (o);
+
 	free (o);
 }
 
-/* returns non-zero if stop state added */
-static int add_state (struct nfa_proc *o, long *set, const struct nfa_state *s)
+/*
+ * Sets the memory limit for lazy DFA cache in bytes, zero disables
+ * lazy DFA. The current match continues with NFA simulation.
+ */
+void nfa_proc_set_cache (struct nfa_proc *o, size_t limit)
 {
-	if (s == NULL)
-		return 1;
+	const uint32_t *set;
+	size_t i;
 
-	if (bitset_is_member (set, s->index))
-		return 0;
+	if (o->state != NULL) {
+		set = dfa_set (o, o->state);
+		sset_clear (&o->cset);
 
-	if (s->from == NFA_SPLIT)
-		return add_state (o, set, s->out[0]) |
-		       add_state (o, set, s->out[1]);
+		for (i = 0; i < o->state->count; ++i)
+			sset_add (&o->cset, set[i]);
 
-	bitset_add (set, s->index);
-	return 0;
+		if (o->bits != NULL)
+			bits_load (o, &o->cset);
+	}
+
+	dfa_clear (o);
+
+	o->limit  = limit;
+	o->misses = 0;
+}
+
+/*
+ * Adds closure of state (or start state closure if index is equal to the
+ * number of states) to the set. Returns color if stop state reachable,
+ * zero otherwise.
+ */
+static int add_closure (struct nfa_proc *o, struct nfa_sset *set,
+			size_t index)
+{
+	uint32_t i;
+
+	for (i = o->first[index]; i < o->first[index + 1]; ++i)
+		sset_add (set, o->list[i]);
+
+	return o->accept[index];
 }
 
 /*
@@ -94,49 +693,274 @@ static int add_state (struct nfa_proc *o, long *set, const struct nfa_state *s)
  */
 int nfa_proc_start (struct nfa_proc *o)
 {
-	bitset_clear (o->cset, o->count);
+	int color;
 
-	if (add_state (o, o->cset, o->start))
-		return o->start->color;
+	if (o->init != NULL) {
+		o->state = o->init;
+		return o->state->color;
+	}
 
-	return 0;
+	if (o->bits != NULL && !dfa_usable (o)) {
+		o->active = o->bits->start;
+		return o->accept[o->count];
+	}
+
+	sset_clear (&o->cset);
+	color = add_closure (o, &o->cset, o->count);
+
+	o->state = dfa_usable (o) ? dfa_intern (o, &o->cset, color) : NULL;
+	o->init  = o->state;
+
+	if (o->state == NULL && o->bits != NULL)
+		bits_load (o, &o->cset);
+
+	return color;
 }
 
 /*
- * returns -1 on error (no match), node color on match, zero otherwise
+ * Moves from one set of states to next one. Returns -1 if no one state
+ * accepts the input, node color on match, zero otherwise.
  */
-int nfa_proc_step (struct nfa_proc *o, int c)
+static int nfa_move (struct nfa_proc *o, const uint32_t *from, size_t count,
+		     struct nfa_sset *to, int c)
 {
 	size_t i;
-	const struct nfa_state *s;
-	int match = 0, error = 1;
-	long *t;
+	const struct nfa_range *s;
+	int color, match = 0, error = 1;
 
-	bitset_clear (o->nset, o->count);
+	sset_clear (to);
 
-	for (
-		i = bitset_find (o->cset, 0, o->count);
-		i < o->count;
-		i = bitset_find (o->cset, i + 1, o->count)
-	) {
-		s = o->map[i];
+	for (i = 0; i < count; ++i) {
+		s = o->range + from[i];
 
 		if (s->from <= c && c <= s->to) {
 			error = 0;
+			color = add_closure (o, to, from[i]);
 
 			/*
 			 * Note that we remember the color of the first
 			 * matching node. Thus, rules added earlier have
 			 * a higher priority.
 			 */
-			if (add_state (o, o->nset, s->out[0]) && match == 0)
-				match = s->color;
+			if (match == 0)
+				match = color;
 		}
 	}
 
-	if (error)
+	return error ? -1 : match;
+}
+
+static int nfa_step (struct nfa_proc *o, int c)
+{
+	int match;
+	struct nfa_sset t;
+
+	match = nfa_move (o, o->cset.dense, o->cset.count, &o->nset, c);
+
+	if (match < 0)
 		return -1;
 
 	t = o->cset; o->cset = o->nset; o->nset = t;  /* swap sets */
 	return match;
 }
+
+static int dfa_step (struct nfa_proc *o, int c)
+{
+	struct nfa_dstate *next;
+	size_t flushes = o->flushes;
+	struct nfa_sset t;
+	int match;
+
+	match = nfa_move (o, dfa_set (o, o->state), o->state->count,
+			  &o->nset, c);
+
+	if (match < 0)
+		next = &dfa_dead;
+	else if ((next = dfa_intern (o, &o->nset, match)) == NULL) {
+		/* out of memory or cache thrashing: fall back to NFA */
+		t = o->cset; o->cset = o->nset; o->nset = t;
+		o->state = NULL;
+
+		if (o->bits != NULL)
+			bits_load (o, &o->cset);
+
+		return match;
+	}
+
+	if (o->flushes == flushes && (unsigned) c < 256)
+		o->state->move[o->class[c]] = next;
+
+	if (next == &dfa_dead)
+		return -1;
+
+	o->state = next;
+	return match;
+}
+
+static int proc_step (struct nfa_proc *o, int c)
+{
+	struct nfa_dstate *next;
+
+	if (o->state == NULL)
+		return o->bits != NULL ? bits_step (o, c) : nfa_step (o, c);
+
+	++o->bytes;
+
+	if ((unsigned) c > 255 || (next = o->state->move[o->class[c]]) == NULL)
+		return dfa_step (o, c);
+
+	if (next->color < 0)
+		return -1;
+
+	o->state = next;
+	return next->color;
+}
+
+/*
+ * Counts the step in the histogram by the number of states left active
+ */
+static void proc_account (struct nfa_proc *o, int color)
+{
+	size_t count, k;
+
+	count = color < 0        ? 0 :
+		o->state != NULL ? o->state->count :
+		o->bits  != NULL ? (size_t) __builtin_popcountll (o->active) :
+				   o->cset.count;
+
+	for (k = 0; count > 0 && k < NFA_PROC_ACTIVE - 1; ++k)
+		count >>= 1;
+
+	++o->stats.bytes;
+	++o->stats.active[k];
+}
+
+/*
+ * returns -1 on error (no match), node color on match, zero otherwise
+ */
+int nfa_proc_step (struct nfa_proc *o, int c)
+{
+	int color;
+
+	nfa_perf_enter (NFA_PERF_STEP);
+	color = proc_step (o, c);
+	nfa_perf_leave (NFA_PERF_STEP);
+
+	if (NFA_STATS)
+		proc_account (o, color);
+
+	return color;
+}
+
+int nfa_proc_stats (const struct nfa_proc *o, struct nfa_proc_stats *s)
+{
+	const size_t n = o->count;
+
+	*s = o->stats;
+
+	s->states = o->total;
+	s->memory = sizeof (*o) + o->used + 2 * n * sizeof (o->cset.dense[0]) +
+		    2 * n * sizeof (o->cset.sparse[0]) + n * sizeof (o->key[0]);
+
+	if (o->base == NULL)
+		s->memory += n * sizeof (o->range[0]) +
+			     (n + 2) * sizeof (o->first[0]) +
+			     (o->first[n + 1] + 1) * sizeof (o->list[0]) +
+			     (n + 1) * sizeof (o->accept[0]) +
+			     (o->bits != NULL ? bits_size (o) : 0);
+
+	return NFA_STATS;
+}
+
+const uint32_t *nfa_proc_active (struct nfa_proc *o, size_t *count)
+{
+	uint64_t set;
+
+	if (o->state != NULL) {
+		*count = o->state->count;
+		return dfa_set (o, o->state);
+	}
+
+	if (o->bits != NULL) {
+		sset_clear (&o->cset);
+
+		for (set = o->active; set != 0; set &= set - 1)
+			sset_add (&o->cset,
+				  o->bits->index[__builtin_ctzll (set)]);
+	}
+
+	*count = o->cset.count;
+	return o->cset.dense;
+}
+
+/*
+ * Rules are disjoint subgraphs of NFA, thus a state belongs to the rule
+ * of the stop state reachable from it. Owners are propagated backwards
+ * along closure lists until there are no changes.
+ */
+int *nfa_proc_owners (const struct nfa_proc *o, size_t *count)
+{
+	int *owner, changed;
+	size_t i, j;
+
+	if ((owner = calloc (o->count + 1, sizeof (owner[0]))) == NULL)
+		return NULL;
+
+	do {
+		for (i = 0, changed = 0; i < o->count; ++i) {
+			if (owner[i] != 0)
+				continue;
+
+			owner[i] = o->accept[i];
+
+			for (j = o->first[i]; j < o->first[i + 1] &&
+					      owner[i] == 0; ++j)
+				owner[i] = owner[o->list[j]];
+
+			changed |= owner[i] != 0;
+		}
+	}
+	while (changed);
+
+	*count = o->count;
+	return owner;
+}
+
+/*
+ * Unanchored search: bytes which cannot start a match are skipped by
+ * prefilter, the longest match is tried at every candidate position
+ */
+int nfa_proc_search (struct nfa_proc *o, const void *data, size_t size,
+		     size_t *pos, size_t *len)
+{
+	const unsigned char *p = data;
+	size_t start, i;
+	int color, c;
+
+	for (start = *pos; start <= size; ++start) {
+		start = nfa_skip (&o->skip, p, start, size);
+
+		if (start == size && !o->skip.prefix.empty)
+			break;
+
+		color = nfa_proc_start (o);
+		*len  = 0;
+
+		for (i = start; i < size;) {
+			if ((c = nfa_proc_step (o, p[i++])) < 0)
+				break;
+
+			if (c > 0) {
+				color = c;
+				*len  = i - start;
+			}
+		}
+
+		if (color > 0) {
+			*pos = start;
+			return color;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * Thompson NFA processor Internals
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_PROC_INT_H
+#define PERUSE_NFA_PROC_INT_H  1
+
+#include <stdint.h>
+
+#include <peruse/nfa-proc.h>
+
+/*
+ * The function nfa_proc_active returns the set of states active after
+ * the last successful step and stores the number of states into count.
+ */
+const uint32_t *nfa_proc_active (struct nfa_proc *o, size_t *count);
+
+/*
+ * The function nfa_proc_owners returns an array of colors of the rules
+ * states belong to (zero if no stop state is reachable from a state),
+ * and stores the number of states into count. The array should be freed
+ * by caller. Returns NULL on error.
+ */
+int *nfa_proc_owners (const struct nfa_proc *o, size_t *count);
+
+#endif  /* PERUSE_NFA_PROC_INT_H */
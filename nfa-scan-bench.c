@@ -0,0 +1,121 @@
+/*
+ * Parallel Thompson NFA-based Lexer Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-lexer.h>
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-scan.h>
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(64 << 20)
+
+struct corpus {
+	const char *data;
+	size_t size, pos;
+};
+
+static size_t corpus_read (void *to, size_t count, void *cookie)
+{
+	struct corpus *o = cookie;
+	size_t avail = o->size - o->pos;
+
+	if (count > avail)
+		count = avail;
+
+	memcpy (to, o->data + o->pos, count);
+	o->pos += count;
+	return count;
+}
+
+/*
+ * Compares token stream of parallel lexer with the stream of sequential
+ * one. Returns the number of tokens, or zero on mismatch.
+ */
+static size_t verify (const struct nfa_scan_chunk *chunk, size_t n,
+		      const char *data, size_t size)
+{
+	struct corpus c = { data, size, 0 };
+	struct nfa_lexer *lex;
+	const struct nfa_token *tok;
+	size_t i, j, count = 0;
+
+	if ((lex = nfa_lexer_alloc (nfa_parse_rules (bench_code_rules ()), 0,
+				    corpus_read, &c)) == NULL)
+		return 0;
+
+	for (i = 0; i < n; ++i)
+		for (j = 0; j < chunk[i].count; ++j, ++count)
+			if ((tok = nfa_lexer (lex)) == NULL ||
+			    tok->color != chunk[i].token[j].color ||
+			    tok->len != chunk[i].token[j].len ||
+			    memcmp (tok->text, chunk[i].token[j].text,
+				    tok->len) != 0)
+				goto mismatch;
+
+	if (nfa_lexer (lex) != NULL)
+		goto mismatch;
+
+	nfa_lexer_free (lex);
+	return count;
+mismatch:
+	nfa_lexer_free (lex);
+	return 0;
+}
+
+static int run (struct bench *o, const void *arg)
+{
+	const size_t *threads = arg;
+	struct nfa_scan *s;
+	const struct nfa_scan_chunk *chunk;
+	char *data;
+	size_t n;
+	double start;
+	int ok = 0;
+
+	if ((data = bench_code (CORPUS_SIZE)) == NULL)
+		return 0;
+
+	if ((s = nfa_scan_alloc (nfa_parse_rules (bench_code_rules ()),
+				 *threads)) == NULL)
+		goto no_scan;
+
+	start   = bench_now ();
+	chunk   = nfa_scan (s, data, CORPUS_SIZE, &n);
+	o->time = bench_now () - start;
+
+	if (chunk == NULL || !nfa_scan_eof (s) ||
+	    (o->tokens = verify (chunk, n, data, CORPUS_SIZE)) == 0)
+		fprintf (stderr, "E: token stream mismatch\n");
+	else
+		ok = 1;
+
+	o->bytes = CORPUS_SIZE;
+
+	nfa_scan_free (s);
+no_scan:
+	free (data);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	size_t limit = argc > 1 ? atoi (argv[1]) : cpus > 0 ? cpus : 1;
+	const char *name = "nfa-scan";
+	char test[32];
+	size_t threads;
+
+	for (threads = 1; threads <= limit; threads *= 2) {
+		snprintf (test, sizeof (test), "threads-%zu", threads);
+
+		if (!bench_run (name, test, run, &threads))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Parallel Thompson NFA-based Lexer Test
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <peruse/nfa-lexer.h>
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-scan.h>
+
+static struct nfa_rule rules[] = {
+	{ rules + 1,	"if|else|while",	10 },
+	{ rules + 2,	"[a-z_][a-z0-9_]*",	11 },
+	{ rules + 3,	"[0-9]+",		12 },
+	{ rules + 4,	"\"[ !#-~]*\"",		13 },
+	{ rules + 5,	"#[ -~]*",		14 },
+	{ rules + 6,	"[-+*/=;(){},]",	15 },
+	{ NULL,		"[ \t\n]+",		16 },
+};
+
+#define CHUNK_SIZE	(64 << 10)	/* minimum chunk of parallel lexer */
+#define MAX_THREADS	8
+#define INPUT_SIZE	(MAX_THREADS * CHUNK_SIZE + 1234)
+
+static unsigned long seed = 1;
+
+static size_t rnd (size_t limit)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) % limit;
+}
+
+static void fill (char *p, size_t len, const char *set)
+{
+	const size_t n = strlen (set);
+
+	for (; len > 0; --len)
+		*p++ = set[rnd (n)];
+}
+
+/*
+ * Program-like text: tokens of random length cross chunk boundaries at
+ * random places
+ */
+static void code_fill (char *data, size_t size)
+{
+	char *p, *end;
+	size_t len;
+
+	for (p = data, end = data + size - 64; p < end; *p++ = ' ') {
+		switch (rnd (6)) {
+		case 0:
+			len = 1 + rnd (12);
+			fill (p, len, "abcdefghijklmnopqrstuvwxyz_");
+			break;
+		case 1:
+			len = 1 + rnd (8);
+			fill (p, len, "0123456789");
+			break;
+		case 2:
+			len = 1;
+			fill (p, len, "+-*/=;(){},");
+			break;
+		case 3:
+			len = 2 + rnd (40);
+			fill (p, len, "abc xyz 0123 +-*/ # ");
+			p[0] = p[len - 1] = '"';
+			break;
+		case 4:
+			len = 2 + rnd (60);
+			fill (p, len, "abc xyz 0123 +-*/ # \"");
+			p[0] = '#';
+			p[len++] = '\n';
+			break;
+		default:
+			len = 1 + rnd (3);
+			fill (p, len, " \t\n");
+			break;
+		}
+
+		p += len;
+	}
+
+	memset (p, ' ', data + size - p);
+}
+
+struct corpus {
+	const char *data;
+	size_t size, pos;
+};
+
+static size_t corpus_read (void *to, size_t count, void *cookie)
+{
+	struct corpus *o = cookie;
+	size_t avail = o->size - o->pos;
+
+	if (count > avail)
+		count = avail;
+
+	memcpy (to, o->data + o->pos, count);
+	o->pos += count;
+	return count;
+}
+
+/*
+ * Compares tokens of parallel lexer with tokens of sequential one, and
+ * checks that no token is found after the stop position of sequential
+ * run. Returns the number of tokens, or zero on mismatch.
+ */
+static size_t
+verify (const struct nfa_scan_chunk *chunk, size_t n, int eof,
+	const char *data, size_t size)
+{
+	struct corpus c = { data, size, 0 };
+	struct nfa_lexer *lex;
+	const struct nfa_token *tok;
+	size_t i, j, count = 0, stop = 0;
+
+	if ((lex = nfa_lexer_alloc (nfa_parse_rules (rules), 0,
+				    corpus_read, &c)) == NULL)
+		return 0;
+
+	for (i = 0; i < n; ++i)
+		for (j = 0; j < chunk[i].count; ++j, ++count) {
+			if ((tok = nfa_lexer (lex)) == NULL ||
+			    tok->color != chunk[i].token[j].color ||
+			    tok->len != chunk[i].token[j].len ||
+			    memcmp (tok->text, chunk[i].token[j].text,
+				    tok->len) != 0)
+				goto mismatch;
+
+			stop = chunk[i].token[j].text + tok->len - data;
+		}
+
+	if (nfa_lexer (lex) != NULL || nfa_lexer_eof (lex) != eof ||
+	    (eof && stop != size))
+		goto mismatch;
+
+	nfa_lexer_free (lex);
+	return count;
+mismatch:
+	nfa_lexer_free (lex);
+	return 0;
+}
+
+static int run (const char *name, const char *data, size_t size)
+{
+	struct nfa_scan *o;
+	const struct nfa_scan_chunk *chunk;
+	size_t threads, n, count = 0;
+	int eof = 1;
+
+	for (threads = 1; threads <= MAX_THREADS; ++threads) {
+		o = nfa_scan_alloc (nfa_parse_rules (rules), threads);
+
+		if (o == NULL ||
+		    (chunk = nfa_scan (o, data, size, &n)) == NULL) {
+			perror ("nfa-scan-test");
+			return 0;
+		}
+
+		eof = nfa_scan_eof (o);
+
+		if (n != threads ||
+		    (count = verify (chunk, n, eof, data, size)) == 0) {
+			fprintf (stderr, "E: %s: %zu threads: token stream "
+				 "mismatch\n", name, threads);
+			nfa_scan_free (o);
+			return 0;
+		}
+
+		nfa_scan_free (o);
+	}
+
+	printf ("scan: %s: %zu tokens, %s\n", name, count,
+		eof ? "eof" : "lexical error");
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	char *data;
+	int ok;
+
+	if ((data = malloc (INPUT_SIZE)) == NULL) {
+		perror ("nfa-scan-test");
+		return 1;
+	}
+
+	code_fill (data, INPUT_SIZE);
+	ok = run ("code", data, INPUT_SIZE);
+
+	/* comment longer than a chunk, from the second chunk to the fourth */
+	memset (data + CHUNK_SIZE + 100, '-', CHUNK_SIZE * 5 / 2);
+	data[CHUNK_SIZE + 99]  = '\n';
+	data[CHUNK_SIZE + 100] = '#';
+	data[CHUNK_SIZE * 7 / 2 + 100] = '\n';
+	ok = ok && run ("long", data, INPUT_SIZE);
+
+	/* lexical error in a middle chunk truncates later chunks */
+	data[CHUNK_SIZE * 9 / 2 + 7] = '\001';
+	ok = ok && run ("error", data, INPUT_SIZE);
+
+	free (data);
+	return ok ? 0 : 1;
+}
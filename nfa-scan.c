@@ -0,0 +1,326 @@
+/*
+ * Parallel Thompson NFA-based Lexer
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <peruse/nfa-proc.h>
+#include <peruse/nfa-scan.h>
+
+#define NFA_SCAN_CHUNK	(64 << 10)	/* minimum chunk size, bytes */
+
+/*
+ * Chunk lexing job: tokens found by speculative run from the start of
+ * the chunk, the run stops at the first token started after the chunk.
+ * On lexical error the error mark (token with zero color) is stored and
+ * the run continues from the next byte.
+ */
+struct scan_job {
+	struct nfa_proc *proc;
+	const unsigned char *data;
+	size_t size, from, to, stop;
+	struct nfa_token *token;
+	size_t count, avail;
+	int error, nomem, spawned;
+	pthread_t thread;
+};
+
+struct nfa_scan {
+	struct nfa_proc *proc;		/* used to resync chunks */
+	size_t threads;
+	struct scan_job *job;
+	struct scan_job head;		/* tokens lexed while resync */
+	struct nfa_scan_chunk *chunk;
+	int eof;
+};
+
+static int job_reserve (struct scan_job *o, size_t count)
+{
+	size_t avail = o->avail == 0 ? 256 : o->avail;
+	struct nfa_token *p;
+
+	if (count <= o->avail)
+		return 1;
+
+	for (; avail < count; avail *= 2) {}
+
+	if ((p = realloc (o->token, avail * sizeof (p[0]))) == NULL)
+		return 0;
+
+	o->token = p;
+	o->avail = avail;
+	return 1;
+}
+
+static int job_push (struct scan_job *o, int color, size_t pos, size_t len)
+{
+	struct nfa_token *p;
+
+	if (!job_reserve (o, o->count + 1))
+		return 0;
+
+	p = o->token + o->count++;
+
+	p->color = color;
+	p->text  = (void *) (o->data + pos);
+	p->len   = len;
+	return 1;
+}
+
+static size_t job_pos (const struct scan_job *o, size_t i)
+{
+	return (const unsigned char *) o->token[i].text - o->data;
+}
+
+/*
+ * Returns length of the longest match at the specified position and
+ * stores its color, zero on error
+ */
+static size_t
+scan_token (struct nfa_proc *p, const unsigned char *data, size_t size,
+	    size_t pos, int *color)
+{
+	size_t i, len = 0;
+	int c;
+
+	*color = nfa_proc_start (p);
+
+	for (i = pos; i < size;) {
+		if ((c = nfa_proc_step (p, data[i++])) < 0)
+			break;
+
+		if (c > 0) {
+			*color = c;
+			len = i - pos;
+		}
+	}
+
+	return *color > 0 ? len : 0;
+}
+
+static void *job_run (void *cookie)
+{
+	struct scan_job *o = cookie;
+	size_t pos, len;
+	int color;
+
+	for (pos = o->from; pos < o->to; pos += len) {
+		if ((len = scan_token (o->proc, o->data, o->size, pos,
+				       &color)) == 0) {
+			o->error = 1;
+			color = 0;
+		}
+
+		if (!job_push (o, color, pos, len)) {
+			o->nomem = 1;
+			break;
+		}
+
+		if (len == 0)
+			len = 1;  /* skip error */
+	}
+
+	o->stop = pos;
+	return NULL;
+}
+
+struct nfa_scan *nfa_scan_alloc (struct nfa_state *start, size_t threads)
+{
+	struct nfa_scan *o;
+	long n;
+	size_t i;
+
+	if (threads == 0)
+		threads = (n = sysconf (_SC_NPROCESSORS_ONLN)) > 0 ? n : 1;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		goto no_obj;
+
+	if ((o->proc = nfa_proc_alloc (start)) == NULL)
+		goto no_proc;
+
+	o->threads = threads;
+
+	if ((o->job = calloc (threads, sizeof (o->job[0]))) == NULL)
+		goto no_job;
+
+	if ((o->chunk = calloc (threads, sizeof (o->chunk[0]))) == NULL)
+		goto no_chunk;
+
+	for (i = 0; i < threads; ++i)
+		if ((o->job[i].proc = nfa_proc_clone (o->proc)) == NULL)
+			goto no_clone;
+
+	memset (&o->head, 0, sizeof (o->head));
+	o->eof = 0;
+	return o;
+no_clone:
+	for (; i > 0; --i)
+		nfa_proc_free (o->job[i - 1].proc);
+
+	free (o->chunk);
+no_chunk:
+	free (o->job);
+no_job:
+	nfa_proc_free (o->proc);
+	free (o);
+	return NULL;
+no_proc:
+	free (o);
+	return NULL;
+no_obj:
+	nfa_state_free (start);
+	return NULL;
+}
+
+void nfa_scan_free (struct nfa_scan *o)
+{
+	size_t i;
+
+	if (o == NULL)
+		return;
+
+	for (i = 0; i < o->threads; ++i) {
+		free (o->job[i].token);
+		nfa_proc_free (o->job[i].proc);
+	}
+
+	free (o->head.token);
+	free (o->chunk);
+	free (o->job);
+	nfa_proc_free (o->proc);
+	free (o);
+}
+
+/*
+ * Lexing is deterministic from any token start, thus the speculative
+ * tokens of the chunk are correct from the first one which starts where
+ * a token of the sequential run starts. Tokens before the sync point are
+ * lexed again here. Returns the start position of the next token, the
+ * end of data on lexical error, or a position after the end of data on
+ * allocation error.
+ */
+static size_t scan_resync (struct nfa_scan *o, struct scan_job *job,
+			   size_t pos)
+{
+	struct scan_job *head = &o->head;
+	size_t i = 0, len, count;
+	int color;
+
+	head->data  = job->data;
+	head->count = 0;
+
+	for (; pos < job->to; pos += len) {
+		for (; i < job->count && job_pos (job, i) < pos; ++i) {}
+
+		if (i < job->count && job_pos (job, i) == pos)
+			goto sync;
+
+		if ((len = scan_token (o->proc, job->data, job->size, pos,
+				       &color)) == 0)
+			goto error;
+
+		if (!job_push (head, color, pos, len))
+			return job->size + 1;
+	}
+
+	job->count = 0;  /* whole chunk lexed again */
+	goto splice;
+error:
+	job->count = 0;
+	goto stop;
+sync:
+	job->count -= i;
+	memmove (job->token, job->token + i,
+		 job->count * sizeof (job->token[0]));
+
+	for (i = 0; job->error && i < job->count; ++i)
+		if (job->token[i].color == 0) {
+			job->count = i;  /* sequential run stops here */
+			goto stop;
+		}
+
+	pos = job->stop;
+	goto splice;
+stop:
+	pos = job->size;
+	o->eof = 0;
+splice:
+	if (head->count == 0)
+		return pos;
+
+	if (!job_reserve (job, (count = job->count) + head->count))
+		return job->size + 1;
+
+	job->count = count + head->count;
+
+	memmove (job->token + head->count, job->token,
+		 count * sizeof (job->token[0]));
+	memcpy (job->token, head->token, head->count * sizeof (job->token[0]));
+	return pos;
+}
+
+const struct nfa_scan_chunk *
+nfa_scan (struct nfa_scan *o, const void *data, size_t size, size_t *count)
+{
+	size_t n, i, pos;
+	struct scan_job *job;
+	int ok = 1;
+
+	n = size / NFA_SCAN_CHUNK;
+	n = n < 1 ? 1 : n > o->threads ? o->threads : n;
+
+	for (i = 0; i < n; ++i) {
+		job = o->job + i;
+
+		job->data  = data;
+		job->size  = size;
+		job->from  = size * i / n;
+		job->to    = size * (i + 1) / n;
+		job->count = 0;
+		job->error = job->nomem = 0;
+
+		/* the first chunk is lexed in this thread */
+		job->spawned = i > 0 &&
+			pthread_create (&job->thread, NULL, job_run, job) == 0;
+	}
+
+	for (i = 0; i < n; ++i)
+		if (!o->job[i].spawned)
+			job_run (o->job + i);
+
+	for (i = 0, pos = 0, o->eof = 1; i < n; ++i) {
+		job = o->job + i;
+
+		if (job->spawned)
+			pthread_join (job->thread, NULL);
+
+		if (job->nomem || pos > size)
+			ok = 0;
+		else if (pos >= job->to)
+			job->count = 0;
+		else
+			pos = scan_resync (o, job, pos);
+
+		o->chunk[i].token = job->token;
+		o->chunk[i].count = job->count;
+	}
+
+	if (!ok)
+		return NULL;
+
+	*count = n;
+	return o->chunk;
+}
+
+int nfa_scan_eof (struct nfa_scan *o)
+{
+	return o->eof;
+}
@@ -0,0 +1,179 @@
+/*
+ * Thompson NFA Processor Search Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(32 << 20)
+#define NEEDLE_GAP	4096
+
+static const struct search_case {
+	const char *name, *re;
+} pattern[] = {
+	{ "words",	"if|then|else"		},  /* few first bytes */
+	{ "prefix",	"/\\*[ -~]*\\*/"	},  /* literal prefix */
+	{ "byte",	"@[a-z]+"		},  /* single first byte */
+	{ "range",	"[0-9]+"		},  /* range of first bytes */
+	{ "ranges",	"[A-Z][a-z]*|[0-9]+"	},  /* several ranges */
+};
+
+/*
+ * Lowercase text without bytes the patterns start with, and rare needles
+ * for every pattern
+ */
+static char *corpus_alloc (size_t size)
+{
+	static const char *text = "abcdfghjkmnopqrsuvwxyz      ,.\n";
+	static const char *needle[] = {
+		"then", "/* note */", "@mail", "2024", "Word",
+	};
+	const size_t n = strlen (text);
+	const char *p;
+	char *data;
+	size_t i;
+
+	if ((data = malloc (size)) == NULL)
+		return NULL;
+
+	for (i = 0; i < size; ++i)
+		data[i] = text[bench_rnd (n)];
+
+	for (i = NEEDLE_GAP; i + 16 < size; i += NEEDLE_GAP) {
+		p = needle[bench_rnd (5)];
+		data[i - 1] = ' ';
+		memcpy (data + i, p, strlen (p));
+		data[i + strlen (p)] = ' ';
+	}
+
+	return data;
+}
+
+/*
+ * Reference search: the automaton is started at every position
+ */
+static int
+naive_search (struct nfa_proc *o, const void *text, size_t size,
+	      size_t *pos, size_t *len)
+{
+	const unsigned char *data = text;
+	size_t start, i;
+	int color, c;
+
+	for (start = *pos; start <= size; ++start) {
+		color = nfa_proc_start (o);
+		*len  = 0;
+
+		for (i = start; i < size;) {
+			if ((c = nfa_proc_step (o, data[i++])) < 0)
+				break;
+
+			if (c > 0) {
+				color = c;
+				*len  = i - start;
+			}
+		}
+
+		if (color > 0) {
+			*pos = start;
+			return color;
+		}
+	}
+
+	return 0;
+}
+
+typedef int search_fn (struct nfa_proc *o, const void *data, size_t size,
+		       size_t *pos, size_t *len);
+
+static size_t
+find (const char *re, search_fn *search, const char *data, size_t size,
+      double *time)
+{
+	struct nfa_proc *o;
+	size_t count, pos, len;
+	double start;
+
+	if ((o = nfa_proc_alloc (nfa_parse_re (re, 1))) == NULL)
+		return 0;
+
+	start = bench_now ();
+
+	for (count = 0, pos = 0; search (o, data, size, &pos, &len) > 0;
+	     ++count)
+		pos += len > 0 ? len : 1;
+
+	*time = bench_now () - start;
+
+	nfa_proc_free (o);
+	return count;
+}
+
+/*
+ * The search is checked to find the same matches as the reference one,
+ * the matches are counted as tokens
+ */
+static int run (struct bench *o, const struct search_case *c, int naive)
+{
+	char *data;
+	size_t ref;
+
+	if ((data = corpus_alloc (CORPUS_SIZE)) == NULL)
+		return 0;
+
+	ref = find (c->re, naive_search, data, CORPUS_SIZE, &o->time);
+
+	if (!naive)
+		o->tokens = find (c->re, nfa_proc_search, data, CORPUS_SIZE,
+				  &o->time);
+	else
+		o->tokens = ref;
+
+	o->bytes = CORPUS_SIZE;
+	free (data);
+
+	if (o->tokens != ref) {
+		fprintf (stderr, "E: %s: %zu matches, expected %zu\n",
+			 c->re, o->tokens, ref);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int run_naive (struct bench *o, const void *arg)
+{
+	return run (o, arg, 1);
+}
+
+static int run_search (struct bench *o, const void *arg)
+{
+	return run (o, arg, 0);
+}
+
+int main (int argc, char *argv[])
+{
+	const char *name = "nfa-search";
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (pattern) / sizeof (pattern[0]); ++i) {
+		snprintf (test, sizeof (test), "%s-naive", pattern[i].name);
+
+		if (!bench_run (name, test, run_naive, pattern + i))
+			return 1;
+
+		snprintf (test, sizeof (test), "%s-search", pattern[i].name);
+
+		if (!bench_run (name, test, run_search, pattern + i))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * NFA Processor Prefiltered Search Test
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+#include "nfa-skip.h"
+
+static const struct search_case {
+	const char *re, *needle;
+} pattern[] = {
+	{ "x?",			"x"	},  /* empty match, no skip */
+	{ "abc[0-9]+",		"abc7"	},  /* literal prefix */
+	{ "@[a-z]+",		"@mail"	},  /* single first byte */
+	{ "[0-9]+",		"42"	},  /* single range of first bytes */
+	{ "[A-Z][a-z]*|[0-9]+",	"Word"	},  /* several ranges */
+	{ "[AEIOU]z|[02468]",	"Oz"	},  /* too many ranges for vector */
+};
+
+static const char *mode_name[] = {
+	"none", "text", "byte", "range", "map",
+};
+
+#define ALPHABET	"bdfhjlnprtvxy ,.\n"  /* no first bytes but x */
+#define SIZE_MAX_TEST	(4096 + 77)
+
+static unsigned long seed = 1;
+
+static size_t rnd (size_t limit)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) % limit;
+}
+
+/*
+ * Reference search: the automaton is started at every position
+ */
+static int
+naive_search (struct nfa_proc *o, const unsigned char *data, size_t size,
+	      size_t *pos, size_t *len)
+{
+	size_t start, i;
+	int color, c;
+
+	for (start = *pos; start <= size; ++start) {
+		color = nfa_proc_start (o);
+		*len  = 0;
+
+		for (i = start; i < size;) {
+			if ((c = nfa_proc_step (o, data[i++])) < 0)
+				break;
+
+			if (c > 0) {
+				color = c;
+				*len  = i - start;
+			}
+		}
+
+		if (color > 0) {
+			*pos = start;
+			return color;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Compares all the matches of search with the reference ones
+ */
+static int
+check_search (struct nfa_proc *o, const unsigned char *data, size_t size)
+{
+	size_t pos = 0, len, ref_pos = 0, ref_len;
+	int color, ref;
+
+	do {
+		ref   = naive_search (o, data, size, &ref_pos, &ref_len);
+		color = nfa_proc_search (o, data, size, &pos, &len);
+
+		if (color != ref || (ref > 0 && (pos != ref_pos ||
+						 len != ref_len)))
+			return 0;
+
+		pos = ref_pos += len > 0 ? len : 1;
+	}
+	while (ref > 0 && pos <= size);
+
+	return 1;
+}
+
+/*
+ * Checks that prefilter never skips a byte which can start a match
+ */
+static int check_skip (const struct nfa_skip *s, const unsigned char *data,
+		       size_t size)
+{
+	size_t pos, i;
+
+	for (pos = 0; pos <= size; ++pos) {
+		i = nfa_skip (s, data, pos, size);
+
+		if (i < pos || i > size)
+			return 0;
+
+		for (; pos < i; ++pos)
+			if (s->prefix.first[data[pos]])
+				return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Checks that every byte which can start a match is in the first map
+ */
+static int check_first (struct nfa_proc *o, const struct nfa_prefix *p)
+{
+	int c;
+
+	for (c = 0; c < 256; ++c) {
+		nfa_proc_start (o);
+
+		if (nfa_proc_step (o, c) >= 0 && !p->first[c])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void
+data_fill (unsigned char *data, size_t size, const char *needle, size_t at)
+{
+	const size_t n = strlen (ALPHABET), len = strlen (needle);
+	size_t i;
+
+	for (i = 0; i < size; ++i)
+		data[i] = ALPHABET[rnd (n)];
+
+	if (at < size && at + len <= size)
+		memcpy (data + at, needle, len);
+	else if (at == size)  /* rare needles at random positions */
+		for (i = rnd (64); i + len <= size; i += 64 + rnd (64))
+			memcpy (data + i, needle, len);
+}
+
+static int run (const struct search_case *c, int avx2)
+{
+	unsigned char data[SIZE_MAX_TEST];
+	struct nfa_prefix prefix;
+	struct nfa_skip skip;
+	struct nfa_proc *o;
+	size_t size, at;
+
+	if (!nfa_state_prefix (nfa_parse_re (c->re, 1), &prefix) ||
+	    (o = nfa_proc_alloc (nfa_parse_re (c->re, 1))) == NULL) {
+		perror ("nfa-search-test");
+		return 0;
+	}
+
+	nfa_skip_init (&skip, &prefix);
+	nfa_skip_vector (avx2);
+
+	if (!check_first (o, &prefix)) {
+		fprintf (stderr, "E: %s: first byte map misses\n", c->re);
+		goto error;
+	}
+
+	for (size = 0; size <= SIZE_MAX_TEST; size += size < 80 ? 1 : 999) {
+		/*
+		 * Needle at offset 0, in the vector tail, or at random
+		 * positions if at is equal to size
+		 */
+		for (at = 0; at <= size; ++at) {
+			if (at > 1 && at + 34 < size)
+				at = size - 34;
+
+			data_fill (data, size, c->needle, at);
+
+			if (!check_skip (&skip, data, size) ||
+			    !check_search (o, data, size)) {
+				fprintf (stderr, "E: %s: %s: size %zu, needle "
+					 "at %zu: search mismatch\n", c->re,
+					 mode_name[skip.mode], size, at);
+				goto error;
+			}
+		}
+	}
+
+	printf ("search: %-20s %-5s %s\n", c->re, mode_name[skip.mode],
+		avx2 ? "auto" : "sse2");
+	nfa_proc_free (o);
+	return 1;
+error:
+	nfa_proc_free (o);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	size_t i;
+	int avx2;
+
+	for (avx2 = 1; avx2 >= 0; --avx2)
+		for (i = 0; i < sizeof (pattern) / sizeof (pattern[0]); ++i)
+			if (!run (pattern + i, avx2))
+				return 1;
+
+	return 0;
+}
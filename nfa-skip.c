@@ -0,0 +1,173 @@
+/*
+ * NFA Prefilter: skip bytes which cannot start a match
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#define _GNU_SOURCE  /* memmem */
+
+#include <string.h>
+
+#include "nfa-skip.h"
+
+#if defined (__GNUC__) && defined (__x86_64__)
+#define NFA_SKIP_SIMD  1
+#include <immintrin.h>
+#endif
+
+void nfa_skip_init (struct nfa_skip *o, const struct nfa_prefix *p)
+{
+	const unsigned char *first = p->first;
+	size_t c, n;
+
+	o->prefix = *p;
+
+	for (c = 0, n = 0; c < 256; ++c) {
+		if (!first[c])
+			continue;
+
+		if ((c == 0 || !first[c - 1]) && n++ < NFA_SKIP_RANGES)
+			o->from[n - 1] = c;
+
+		if ((c == 255 || !first[c + 1]) && n <= NFA_SKIP_RANGES)
+			o->to[n - 1] = c;
+	}
+
+	o->ranges = n;
+
+	if (p->empty || (n == 1 && o->from[0] == 0 && o->to[0] == 255))
+		o->mode = NFA_SKIP_NONE;
+	else if (p->len > 1)
+		o->mode = NFA_SKIP_TEXT;
+	else if (n == 1 && o->from[0] == o->to[0])
+		o->mode = NFA_SKIP_BYTE;
+#ifdef NFA_SKIP_SIMD
+	else if (n <= NFA_SKIP_RANGES)
+		o->mode = NFA_SKIP_RANGE;
+#endif
+	else
+		o->mode = NFA_SKIP_MAP;
+}
+
+static size_t skip_map (const struct nfa_skip *o, const unsigned char *data,
+			size_t pos, size_t size)
+{
+	for (; pos < size && !o->prefix.first[data[pos]]; ++pos) {}
+
+	return pos;
+}
+
+/*
+ * Vector range scan: byte x is in range [from, to] iff unsigned x - from
+ * is not greater than to - from, SSE2 is always available on x86-64, AVX2
+ * is selected at run time
+ */
+#ifdef NFA_SKIP_SIMD
+
+__attribute__ ((target ("avx2")))
+static size_t avx2_skip (const struct nfa_skip *o, const unsigned char *data,
+			 size_t pos, size_t size)
+{
+	__m256i from[NFA_SKIP_RANGES], span[NFA_SKIP_RANGES], x, t, acc;
+	size_t i;
+	unsigned mask;
+
+	for (i = 0; i < o->ranges; ++i) {
+		from[i] = _mm256_set1_epi8 (o->from[i]);
+		span[i] = _mm256_set1_epi8 (o->to[i] - o->from[i]);
+	}
+
+	for (; pos + 32 <= size; pos += 32) {
+		x   = _mm256_loadu_si256 ((const void *) (data + pos));
+		acc = _mm256_setzero_si256 ();
+
+		for (i = 0; i < o->ranges; ++i) {
+			t   = _mm256_sub_epi8 (x, from[i]);
+			t   = _mm256_cmpeq_epi8 (_mm256_min_epu8 (t, span[i]), t);
+			acc = _mm256_or_si256 (acc, t);
+		}
+
+		if ((mask = _mm256_movemask_epi8 (acc)) != 0)
+			return pos + __builtin_ctz (mask);
+	}
+
+	return skip_map (o, data, pos, size);
+}
+
+static size_t sse2_skip (const struct nfa_skip *o, const unsigned char *data,
+			 size_t pos, size_t size)
+{
+	__m128i from[NFA_SKIP_RANGES], span[NFA_SKIP_RANGES], x, t, acc;
+	size_t i;
+	unsigned mask;
+
+	for (i = 0; i < o->ranges; ++i) {
+		from[i] = _mm_set1_epi8 (o->from[i]);
+		span[i] = _mm_set1_epi8 (o->to[i] - o->from[i]);
+	}
+
+	for (; pos + 16 <= size; pos += 16) {
+		x   = _mm_loadu_si128 ((const void *) (data + pos));
+		acc = _mm_setzero_si128 ();
+
+		for (i = 0; i < o->ranges; ++i) {
+			t   = _mm_sub_epi8 (x, from[i]);
+			t   = _mm_cmpeq_epi8 (_mm_min_epu8 (t, span[i]), t);
+			acc = _mm_or_si128 (acc, t);
+		}
+
+		if ((mask = _mm_movemask_epi8 (acc)) != 0)
+			return pos + __builtin_ctz (mask);
+	}
+
+	return skip_map (o, data, pos, size);
+}
+
+static int skip_avx2 = -1;
+
+static int has_avx2 (void)
+{
+	if (skip_avx2 < 0)
+		skip_avx2 = __builtin_cpu_supports ("avx2");
+
+	return skip_avx2;
+}
+
+#endif  /* NFA_SKIP_SIMD */
+
+void nfa_skip_vector (int avx2)
+{
+#ifdef NFA_SKIP_SIMD
+	skip_avx2 = avx2 ? __builtin_cpu_supports ("avx2") : 0;
+#endif
+}
+
+size_t nfa_skip (const struct nfa_skip *o, const unsigned char *data,
+		 size_t pos, size_t size)
+{
+	const unsigned char *p;
+
+	if (pos >= size)
+		return size;
+
+	switch (o->mode) {
+	case NFA_SKIP_NONE:
+		return pos;
+	case NFA_SKIP_TEXT:
+		p = memmem (data + pos, size - pos, o->prefix.text,
+			    o->prefix.len);
+		return p == NULL ? size : (size_t) (p - data);
+	case NFA_SKIP_BYTE:
+		p = memchr (data + pos, o->from[0], size - pos);
+		return p == NULL ? size : (size_t) (p - data);
+#ifdef NFA_SKIP_SIMD
+	case NFA_SKIP_RANGE:
+		return has_avx2 () ? avx2_skip (o, data, pos, size) :
+				     sse2_skip (o, data, pos, size);
+#endif
+	default:
+		return skip_map (o, data, pos, size);
+	}
+}
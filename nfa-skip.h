@@ -0,0 +1,47 @@
+/*
+ * NFA Prefilter: skip bytes which cannot start a match
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_SKIP_H
+#define PERUSE_NFA_SKIP_H  1
+
+#include <peruse/nfa-state.h>
+
+#define NFA_SKIP_RANGES	4	/* maximum number of ranges for vector scan */
+
+enum nfa_skip_mode {
+	NFA_SKIP_NONE,		/* any byte can start a match */
+	NFA_SKIP_TEXT,		/* search for the literal prefix */
+	NFA_SKIP_BYTE,		/* search for the single first byte */
+	NFA_SKIP_RANGE,		/* vector scan for a few ranges of bytes */
+	NFA_SKIP_MAP,		/* scan with first byte map */
+};
+
+struct nfa_skip {
+	struct nfa_prefix prefix;
+	enum nfa_skip_mode mode;
+	size_t ranges;
+	unsigned char from[NFA_SKIP_RANGES], to[NFA_SKIP_RANGES];
+};
+
+void nfa_skip_init (struct nfa_skip *o, const struct nfa_prefix *p);
+
+/*
+ * Returns position of the first byte at or after pos which can start
+ * a match, or size if there are no such bytes
+ */
+size_t nfa_skip (const struct nfa_skip *o, const unsigned char *data,
+		 size_t pos, size_t size);
+
+/*
+ * The function nfa_skip_vector limits vector scan to SSE2 if avx2 is
+ * zero, or allows AVX2 if CPU supports it otherwise. It is used by tests
+ * to cover both kernels.
+ */
+void nfa_skip_vector (int avx2);
+
+#endif  /* PERUSE_NFA_SKIP_H */
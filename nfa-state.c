@@ -8,17 +8,110 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "nfa-state.h"
 
+#define NFA_CHUNK_MAX	4096
+
+struct nfa_chunk {
+	struct nfa_chunk *next;
+	struct nfa_state state[];
+};
+
+struct nfa_arena {
+	struct nfa_chunk *chunk, *last;	/* the first chunk is current */
+	size_t used, avail, hint;
+	size_t refs;
+};
+
+struct nfa_arena *nfa_arena_alloc (size_t hint)
+{
+	struct nfa_arena *o;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	o->chunk = o->last = NULL;
+	o->used  = o->avail = 0;
+	o->hint  = hint == 0 ? 1 : hint > NFA_CHUNK_MAX ? NFA_CHUNK_MAX : hint;
+	o->refs  = 1;
+	return o;
+}
+
+void nfa_arena_free (struct nfa_arena *o)
+{
+	struct nfa_chunk *next;
+
+	if (o == NULL || --o->refs > 0)
+		return;
+
+	for (; o->chunk != NULL; o->chunk = next) {
+		next = o->chunk->next;
+		free (o->chunk);
+	}
+
+	free (o);
+}
+
+static int nfa_arena_grow (struct nfa_arena *o)
+{
+	struct nfa_chunk *c;
+
+	if ((c = malloc (sizeof (*c) + o->hint * sizeof (c->state[0]))) == NULL)
+		return 0;
+
+	c->next  = o->chunk;
+	o->chunk = c;
+
+	if (o->last == NULL)
+		o->last = c;
+
+	o->used  = 0;
+	o->avail = o->hint;
+
+	if (o->hint < NFA_CHUNK_MAX)
+		o->hint *= 2;
+
+	return 1;
+}
+
+/*
+ * Two NFA heads are united into one: returns arena of the result
+ */
+static struct nfa_arena *nfa_unite (struct nfa_arena *x, struct nfa_arena *y)
+{
+	struct nfa_arena *t;
+
+	if (x == y) {
+		--x->refs;
+		return x;
+	}
+
+	if (y->refs > 1)
+		t = x, x = y, y = t;  /* y owned by one head only */
+
+	y->last->next  = x->chunk->next;
+	x->chunk->next = y->chunk;
+
+	if (x->last == x->chunk)
+		x->last = y->last;
+
+	free (y);
+	return x;
+}
+
 static struct nfa_state *
-nfa_state (int from, int to, struct nfa_state *a, struct nfa_state *b)
+nfa_state (struct nfa_arena *arena, int from, int to, struct nfa_state *a,
+	   struct nfa_state *b)
 {
 	struct nfa_state *o;
 
-	if ((o = malloc (sizeof (*o))) == NULL)
+	if (arena->used == arena->avail && !nfa_arena_grow (arena))
 		return NULL;
 
+	o = arena->chunk->state + arena->used++;
+
 	o->next = NULL;
 	o->from = from;
 	o->to   = to;
@@ -28,17 +121,33 @@ nfa_state (int from, int to, struct nfa_state *a, struct nfa_state *b)
 	o->out[1] = b;
 
 	o->color = 1;
+
+	o->last  = o;
+	o->patch = a == NULL || b == NULL ? o : NULL;
+	o->link  = o;
+	o->arena = arena;
 	return o;
 }
 
-void nfa_state_free (struct nfa_state *o)
+struct nfa_state *nfa_arena_range (struct nfa_arena *o, int from, int to)
 {
-	struct nfa_state *next;
+	struct nfa_state *s;
 
-	for (; o != NULL; o = next) {
-		next = o->next;
-		free (o);
+	if (from < 0 || to < 0) {
+		errno = EINVAL;
+		return NULL;
 	}
+
+	if ((s = nfa_state (o, from, to, NULL, NULL)) != NULL)
+		++o->refs;
+
+	return s;
+}
+
+void nfa_state_free (struct nfa_state *o)
+{
+	if (o != NULL)
+		nfa_arena_free (o->arena);
 }
 
 void nfa_state_order (struct nfa_state *o)
@@ -49,6 +158,208 @@ void nfa_state_order (struct nfa_state *o)
 		o->index = i;
 }
 
+static int closure_push (const struct nfa_state *s, size_t stamp,
+			 size_t *mark, const struct nfa_state **stack,
+			 size_t *top)
+{
+	if (s == NULL)
+		return 1;  /* stop state reached */
+
+	if (mark[s->index] != stamp) {
+		mark[s->index] = stamp;
+		stack[(*top)++] = s;
+	}
+
+	return 0;
+}
+
+static int closure_add (struct nfa_closure *o, size_t *len, size_t *avail,
+			size_t x)
+{
+	size_t next;
+	size_t *p;
+
+	if (*len == *avail) {
+		next = *avail == 0 ? 16 : *avail * 2;
+
+		if ((p = realloc (o->list, next * sizeof (p[0]))) == NULL)
+			return 0;
+
+		o->list = p;
+		*avail = next;
+	}
+
+	o->list[(*len)++] = x;
+	return 1;
+}
+
+int nfa_closure_init (struct nfa_closure *o, const struct nfa_state *nfa,
+		      size_t count)
+{
+	const struct nfa_state **stack, *p, *s, *root;
+	size_t *mark, i, top, len = 0, avail = 0;
+	int stop, color;
+
+	o->first  = malloc ((count + 2) * sizeof (o->first[0]));
+	o->list   = NULL;
+	o->accept = malloc ((count + 1) * sizeof (o->accept[0]));
+
+	mark  = calloc (count + 1, sizeof (mark[0]));
+	stack = malloc ((count + 1) * sizeof (stack[0]));
+
+	if (o->first == NULL || o->accept == NULL || mark == NULL ||
+	    stack == NULL)
+		goto error;
+
+	for (i = 0, p = nfa; i <= count; ++i) {
+		o->first[i]  = len;
+		o->accept[i] = 0;
+
+		if (i < count) {
+			root  = p->out[0];
+			color = p->color;
+			s = p;
+			p = p->next;
+
+			if (s->from == NFA_SPLIT)
+				continue;
+		}
+		else {
+			root  = nfa;
+			color = nfa->color;
+		}
+
+		top  = 0;
+		stop = closure_push (root, i + 1, mark, stack, &top);
+
+		while (top > 0) {
+			s = stack[--top];
+
+			if (s->from != NFA_SPLIT) {
+				if (!closure_add (o, &len, &avail, s->index))
+					goto error;
+
+				continue;
+			}
+
+			stop |= closure_push (s->out[1], i + 1, mark, stack, &top);
+			stop |= closure_push (s->out[0], i + 1, mark, stack, &top);
+		}
+
+		if (stop)
+			o->accept[i] = color;
+	}
+
+	o->first[count + 1] = len;
+
+	free (stack);
+	free (mark);
+	return 1;
+error:
+	free (stack);
+	free (mark);
+	nfa_closure_fini (o);
+	o->first = o->list = NULL;
+	o->accept = NULL;
+	return 0;
+}
+
+void nfa_closure_fini (struct nfa_closure *o)
+{
+	free (o->accept);
+	free (o->list);
+	free (o->first);
+}
+
+int nfa_closure_prefix (const struct nfa_closure *o,
+			const struct nfa_state **map, size_t count,
+			struct nfa_prefix *p)
+{
+	const struct nfa_state *s;
+	size_t *cur, *next, *mark, *t, n, m, i, j, stamp;
+	int c, stop;
+
+	memset (p->first, 0, sizeof (p->first));
+	p->empty = o->accept[count] != 0;
+	p->len   = 0;
+
+	for (i = o->first[count]; i < o->first[count + 1]; ++i)
+		for (s = map[o->list[i]], c = s->from; c <= s->to && c < 256; ++c)
+			p->first[c] = 1;
+
+	cur  = malloc (count * sizeof (cur[0]));
+	next = malloc (count * sizeof (next[0]));
+	mark = calloc (count, sizeof (mark[0]));
+
+	if (cur == NULL || next == NULL || mark == NULL)
+		goto error;
+
+	n = o->first[count + 1] - o->first[count];
+	memcpy (cur, o->list + o->first[count], n * sizeof (cur[0]));
+
+	/*
+	 * Every match starts with the byte if all the states we are in
+	 * consume the same single byte, and no one match ends here
+	 */
+	for (stop = p->empty, stamp = 1; !stop && n > 0; ++stamp) {
+		c = map[cur[0]]->from;
+
+		for (i = 0; i < n; ++i)
+			if (map[cur[i]]->from != c || map[cur[i]]->to != c)
+				goto done;
+
+		if (c > 255 || p->len >= NFA_PREFIX_MAX)
+			break;
+
+		p->text[p->len++] = c;
+
+		for (i = 0, m = 0; i < n; ++i) {
+			stop |= o->accept[cur[i]] != 0;
+
+			for (j = o->first[cur[i]]; j < o->first[cur[i] + 1]; ++j)
+				if (mark[o->list[j]] != stamp) {
+					mark[o->list[j]] = stamp;
+					next[m++] = o->list[j];
+				}
+		}
+
+		t = cur, cur = next, next = t, n = m;
+	}
+done:
+	free (mark);
+	free (next);
+	free (cur);
+	return 1;
+error:
+	free (mark);
+	free (next);
+	free (cur);
+	return 0;
+}
+
+size_t nfa_state_classes (const struct nfa_state *o, unsigned char *map)
+{
+	char edge[257] = { 1 };  /* class starts at this byte */
+	size_t count, c;
+
+	for (; o != NULL; o = o->next) {
+		if (o->from == NFA_SPLIT || o->from > 255)
+			continue;
+
+		edge[o->from] = 1;
+
+		if (o->to < 255)
+			edge[o->to + 1] = 1;
+	}
+
+	for (count = 0, c = 0; c < 256; ++c) {
+		count += edge[c];
+		map[c] = count - 1;
+	}
+
+	return count;
+}
+
 size_t nfa_state_count (const struct nfa_state *o)
 {
 	size_t count;
@@ -59,6 +370,34 @@ size_t nfa_state_count (const struct nfa_state *o)
 	return count;
 }
 
+int nfa_state_prefix (struct nfa_state *o, struct nfa_prefix *p)
+{
+	const size_t count = nfa_state_count (o);
+	const struct nfa_state **map, *s;
+	struct nfa_closure c;
+	size_t i;
+	int ok;
+
+	nfa_state_order (o);
+
+	if ((map = malloc (count * sizeof (map[0]))) == NULL)
+		return 0;
+
+	for (s = o, i = 0; s != NULL; s = s->next, ++i)
+		map[i] = s;
+
+	if (!nfa_closure_init (&c, o, count)) {
+		free (map);
+		return 0;
+	}
+
+	ok = nfa_closure_prefix (&c, map, count, p);
+
+	nfa_closure_fini (&c);
+	free (map);
+	return ok;
+}
+
 void nfa_state_color (struct nfa_state *o, int color)
 {
 	for (; o != NULL; o = o->next)
@@ -69,22 +408,20 @@ void nfa_state_color (struct nfa_state *o, int color)
 
 struct nfa_state *nfa_state_atom (int c)
 {
-	if (c < 0) {
-		errno = EINVAL;
-		return NULL;
-	}
-
-	return nfa_state (c, c, NULL, NULL);
+	return nfa_state_range (c, c);
 }
 
 struct nfa_state *nfa_state_range (int from, int to)
 {
-	if (from < 0 || to < 0) {
-		errno = EINVAL;
+	struct nfa_arena *arena;
+	struct nfa_state *o;
+
+	if ((arena = nfa_arena_alloc (1)) == NULL)
 		return NULL;
-	}
 
-	return nfa_state (from, to, NULL, NULL);
+	o = nfa_arena_range (arena, from, to);
+	nfa_arena_free (arena);
+	return o;
 }
 
 /* NFA node helper ops */
@@ -93,7 +430,7 @@ static struct nfa_state *nfa_split (struct nfa_state *a, struct nfa_state *b)
 {
 	struct nfa_state *o;
 
-	if ((o = nfa_state (NFA_SPLIT, 0, a, b)) == NULL)
+	if ((o = nfa_state (a->arena, NFA_SPLIT, 0, a, b)) == NULL)
 		goto no_state;
 
 	return o;
@@ -105,22 +442,49 @@ no_state:
 
 static void nfa_merge (struct nfa_state *o, struct nfa_state *b)
 {
-	struct nfa_state *tail;
+	o->last->next = b;
+	o->last = b->last;
+}
+
+/*
+ * Returns the last state of concatenation of two circular patch lists
+ * given by their last states
+ */
+static struct nfa_state *nfa_patch (struct nfa_state *a, struct nfa_state *b)
+{
+	struct nfa_state *first;
 
-	for (tail = o; tail->next != NULL; tail = tail->next) {}
+	if (a == NULL)
+		return b;
+
+	if (b != NULL) {
+		first   = a->link;
+		a->link = b->link;
+		b->link = first;
+	}
 
-	tail->next = b;
+	return b;
 }
 
 static void nfa_join (struct nfa_state *a, struct nfa_state *b)
 {
-	for (; a != NULL; a = a->next) {
-		if (a->out[0] == NULL)
-			a->out[0] = b;
+	struct nfa_state *last = a->patch, *s;
 
-		if (a->out[1] == NULL)
-			a->out[1] = b;
+	if (last == NULL)
+		return;
+
+	for (s = last->link;; s = s->link) {
+		if (s->out[0] == NULL)
+			s->out[0] = b;
+
+		if (s->out[1] == NULL)
+			s->out[1] = b;
+
+		if (s == last)
+			break;
 	}
+
+	a->patch = NULL;
 }
 
 /* NFA compound node constructors */
@@ -129,6 +493,8 @@ struct nfa_state *nfa_state_cat (struct nfa_state *a, struct nfa_state *b)
 {
 	nfa_join  (a, b);
 	nfa_merge (a, b);
+	a->patch = b->patch;
+	a->arena = nfa_unite (a->arena, b->arena);
 	return a;
 }
 
@@ -141,6 +507,8 @@ struct nfa_state *nfa_state_union (struct nfa_state *a, struct nfa_state *b)
 
 	nfa_merge (o, a);
 	nfa_merge (o, b);
+	o->patch = nfa_patch (a->patch, b->patch);
+	o->arena = nfa_unite (a->arena, b->arena);
 	return o;
 }
 
@@ -152,6 +520,7 @@ struct nfa_state *nfa_state_opt (struct nfa_state *a)
 		return NULL;
 
 	nfa_merge (o, a);
+	o->patch = nfa_patch (o->patch, a->patch);
 	return o;
 }
 
@@ -176,5 +545,6 @@ struct nfa_state *nfa_state_plus (struct nfa_state *a)
 
 	nfa_join  (a, o);
 	nfa_merge (a, o);
+	a->patch = o->patch;
 	return a;
 }
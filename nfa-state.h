@@ -22,11 +22,67 @@ struct nfa_state {
 
 	int from, to;
 	int color;	/* used by lexer to distinguish rules, 1 by default */
+
+	/*
+	 * Used by constructors: the last state of the list and the last
+	 * state of circular list of states with dangling (NULL) outputs
+	 * are valid for the head of NFA only
+	 */
+	struct nfa_state *last, *patch, *link;
+	struct nfa_arena *arena;
 };
 
+/*
+ * All states of NFA are allocated from one arena, the arena is freed at
+ * once when its last owner releases it. The arena creator and every NFA
+ * head in the arena are the owners. Combinators unite arenas of their
+ * arguments, an arena used to construct several NFAs can be united with
+ * an arena of one complete NFA only.
+ *
+ * The hint is the expected number of states.
+ */
+struct nfa_arena *nfa_arena_alloc (size_t hint);
+void nfa_arena_free (struct nfa_arena *o);
+
+struct nfa_state *nfa_arena_range (struct nfa_arena *o, int from, int to);
+
 /*
  * Set up indexes for NFA state list
  */
 void nfa_state_order (struct nfa_state *o);
 
+/*
+ * Epsilon closures of NFA: for every consuming state the list of consuming
+ * states reachable from its output by empty transitions, and the color of
+ * state if stop state is reachable this way, zero otherwise. The last
+ * entry (with index equal to the number of states) describes closure of
+ * start state.
+ *
+ * NOTE: NFA should be ordered before closure computation.
+ */
+struct nfa_closure {
+	size_t *first;	/* list ranges, count + 2 entries */
+	size_t *list;	/* state indexes */
+	int *accept;	/* color if stop state reachable */
+};
+
+int  nfa_closure_init (struct nfa_closure *o, const struct nfa_state *nfa,
+		       size_t count);
+void nfa_closure_fini (struct nfa_closure *o);
+
+/*
+ * Extract prefix of NFA using its closures and the map of state indexes
+ * to states. Returns 1 on success, or zero on allocation error.
+ */
+int nfa_closure_prefix (const struct nfa_closure *o,
+			const struct nfa_state **map, size_t count,
+			struct nfa_prefix *p);
+
+/*
+ * Split byte alphabet into classes of bytes that no one state of NFA can
+ * distinguish. Fills the map of bytes to classes and returns the number
+ * of classes.
+ */
+size_t nfa_state_classes (const struct nfa_state *o, unsigned char *map);
+
 #endif  /* PERUSE_NFA_STATE_INT_H */
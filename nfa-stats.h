@@ -0,0 +1,32 @@
+/*
+ * Runtime Statistics Internals
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef PERUSE_NFA_STATS_H
+#define PERUSE_NFA_STATS_H  1
+
+/*
+ * Counters are maintained only if the library is built with PERUSE_STATS
+ * defined, otherwise the updates compile to nothing
+ */
+#ifdef PERUSE_STATS
+
+#define NFA_STATS	1
+
+#define nfa_stats_inc(x)	((void) ++(x))
+#define nfa_stats_add(x, n)	((void) ((x) += (n)))
+
+#else
+
+#define NFA_STATS	0
+
+#define nfa_stats_inc(x)	((void) 0)
+#define nfa_stats_add(x, n)	((void) 0)
+
+#endif
+
+#endif  /* PERUSE_NFA_STATS_H */
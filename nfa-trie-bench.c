@@ -0,0 +1,206 @@
+/*
+ * Literal Trie Lexer Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <peruse/nfa-lexer.h>
+#include <peruse/nfa-parse.h>
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(8 << 20)
+#define WINDOW_SIZE	(64 << 10)
+#define WORD_SIZE	12
+#define NFA_LIMIT	1000	/* NFA of the whole dictionary is too slow */
+
+static void word_init (char *word)
+{
+	size_t len = 3 + bench_rnd (WORD_SIZE - 4);
+
+	bench_fill (word, len, "abcdefghijklmnopqrstuvwxyz");
+	word[len] = '\0';
+}
+
+/*
+ * Dictionary of count random words followed by identifier and space rules
+ */
+static struct nfa_rule *rules_alloc (size_t count, char **words)
+{
+	struct nfa_rule *o;
+	size_t i;
+
+	if ((o = malloc ((count + 2) * sizeof (o[0]))) == NULL)
+		return NULL;
+
+	if ((*words = malloc (count * WORD_SIZE)) == NULL) {
+		free (o);
+		return NULL;
+	}
+
+	for (i = 0; i < count; ++i) {
+		o[i].re = *words + i * WORD_SIZE;
+		o[i].color = 3 + i;
+		word_init (o[i].re);
+	}
+
+	o[i].re = "[a-z]+";
+	o[i].color = 1;
+	o[++i].re = "[ \n]+";
+	o[i].color = 2;
+
+	for (i = 0; i < count + 2; ++i)
+		o[i].next = i + 1 < count + 2 ? o + i + 1 : NULL;
+
+	return o;
+}
+
+struct corpus {
+	char *data;
+	size_t size, pos;
+};
+
+/*
+ * Dictionary words mixed with random identifiers
+ */
+static int corpus_init (struct corpus *o, const struct nfa_rule *rules,
+			size_t count)
+{
+	char word[WORD_SIZE];
+	const char *p;
+	size_t len;
+
+	if ((o->data = malloc (CORPUS_SIZE)) == NULL)
+		return 0;
+
+	for (o->size = 0;; o->size += len + 1) {
+		if (bench_rnd (2)) {
+			word_init (word);
+			p = word;
+		}
+		else
+			p = rules[bench_rnd (count)].re;
+
+		if (o->size + (len = strlen (p)) + 1 > CORPUS_SIZE)
+			break;
+
+		memcpy (o->data + o->size, p, len);
+		o->data[o->size + len] = bench_rnd (8) == 0 ? '\n' : ' ';
+	}
+
+	o->pos = 0;
+	return 1;
+}
+
+static size_t corpus_read (void *to, size_t count, void *cookie)
+{
+	struct corpus *o = cookie;
+	size_t avail = o->size - o->pos;
+
+	if (count > avail)
+		count = avail;
+
+	memcpy (to, o->data + o->pos, count);
+	o->pos += count;
+	return count;
+}
+
+enum lexer_type {
+	LEXER_NFA, LEXER_RULES,
+};
+
+struct trie_case {
+	enum lexer_type type;
+	size_t count;		/* number of literals */
+	int build;		/* measure lexer build instead of scan */
+};
+
+/*
+ * Build cases count literal bytes as bytes and rules as tokens
+ */
+static int run (struct bench *o, const void *arg)
+{
+	const struct trie_case *t = arg;
+	struct nfa_rule *rules;
+	struct nfa_lexer *lex;
+	struct corpus c;
+	char *words;
+	size_t i;
+	double start;
+	int ok = 0;
+
+	if ((rules = rules_alloc (t->count, &words)) == NULL)
+		return 0;
+
+	if (!corpus_init (&c, rules, t->count))
+		goto no_corpus;
+
+	start = bench_now ();
+
+	lex = t->type == LEXER_RULES ?
+	      nfa_lexer_alloc_rules (rules, WINDOW_SIZE, corpus_read, &c) :
+	      nfa_lexer_alloc (nfa_parse_rules (rules), WINDOW_SIZE,
+			       corpus_read, &c);
+	if (lex == NULL)
+		goto no_lexer;
+
+	if (t->build) {
+		o->time = bench_now () - start;
+
+		for (i = 0; i < t->count; ++i)
+			o->bytes += strlen (rules[i].re);
+
+		o->tokens = t->count + 2;
+		ok = 1;
+		goto done;
+	}
+
+	start = bench_now ();
+
+	for (o->tokens = 0; nfa_lexer (lex) != NULL; ++o->tokens) {}
+
+	o->time  = bench_now () - start;
+	o->bytes = c.size;
+
+	if (!(ok = nfa_lexer_eof (lex)))
+		fprintf (stderr, "E: lexical error at token %zu\n", o->tokens);
+done:
+	nfa_lexer_free (lex);
+no_lexer:
+	free (c.data);
+no_corpus:
+	free (words);
+	free (rules);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	static const char *type[] = { "nfa", "trie" };
+	static const size_t count[] = { 100, 1000, 10000, 50000 };
+	const char *name = "nfa-trie";
+	struct trie_case t;
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (count) / sizeof (count[0]); ++i)
+		for (t.type = LEXER_NFA; t.type <= LEXER_RULES; ++t.type) {
+			if (t.type == LEXER_NFA && count[i] > NFA_LIMIT)
+				continue;
+
+			t.count = count[i];
+
+			for (t.build = 1; t.build >= 0; --t.build) {
+				snprintf (test, sizeof (test), "%s-%zu-%s",
+					  t.build ? "build" : "scan",
+					  count[i], type[t.type]);
+
+				if (!bench_run (name, test, run, &t))
+					return 1;
+			}
+		}
+
+	return 0;
+}
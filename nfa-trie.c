@@ -0,0 +1,337 @@
+/*
+ * Literal Trie Matcher
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <peruse/nfa-trie.h>
+
+#define TRIE_NONE	UINT_MAX
+
+/*
+ * Trie node while building: list of children and match color
+ */
+struct trie_node {
+	unsigned child, sibling;	/* zero if none, root is never a child */
+	int color;
+	unsigned char c;
+};
+
+/*
+ * Double-array trie: state s moves by byte c into state t = base[s] + c
+ * if check[t] = s, the root state is zero
+ */
+struct nfa_trie {
+	struct trie_node *node;
+	size_t count, avail;
+
+	unsigned *base, *check;
+	int *color;
+	size_t size;
+
+	unsigned *next, *prev;	/* list of free slots while compiling */
+	unsigned free, last;
+
+	unsigned state;
+	int ready;
+};
+
+static unsigned trie_node (struct nfa_trie *o, int c)
+{
+	const size_t avail = o->avail == 0 ? 64 : o->avail * 2;
+	struct trie_node *p;
+
+	if (o->count >= UINT_MAX)
+		return 0;
+
+	if (o->count >= o->avail) {
+		if ((p = realloc (o->node, avail * sizeof (p[0]))) == NULL)
+			return 0;
+
+		o->node  = p;
+		o->avail = avail;
+	}
+
+	p = o->node + o->count;
+
+	p->child = p->sibling = 0;
+	p->color = 0;
+	p->c     = c;
+	return o->count++;
+}
+
+struct nfa_trie *nfa_trie_alloc (void)
+{
+	struct nfa_trie *o;
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	o->node  = NULL;
+	o->count = o->avail = 0;
+
+	o->base  = o->check = NULL;
+	o->color = NULL;
+	o->size  = 0;
+
+	o->next  = o->prev = NULL;
+
+	o->state = 0;
+	o->ready = 0;
+
+	trie_node (o, 0);  /* root */
+
+	if (o->count == 0) {
+		free (o);
+		return NULL;
+	}
+
+	return o;
+}
+
+void nfa_trie_free (struct nfa_trie *o)
+{
+	if (o == NULL)
+		return;
+
+	free (o->color);
+	free (o->check);
+	free (o->base);
+	free (o->node);
+	free (o);
+}
+
+int nfa_trie_add (struct nfa_trie *o, const void *text, size_t len,
+		  int color)
+{
+	const unsigned char *p = text;
+	unsigned s, t;
+	size_t i;
+
+	for (s = 0, i = 0; i < len; ++i, s = t) {
+		for (
+			t = o->node[s].child;
+			t != 0 && o->node[t].c != p[i];
+			t = o->node[t].sibling
+		) {}
+
+		if (t == 0) {
+			if ((t = trie_node (o, p[i])) == 0)
+				return 0;
+
+			o->node[t].sibling = o->node[s].child;
+			o->node[s].child = t;
+		}
+	}
+
+	if (o->node[s].color == 0)
+		o->node[s].color = color;
+
+	o->ready = 0;
+	return 1;
+}
+
+size_t nfa_trie_count (const struct nfa_trie *o)
+{
+	return o->count;
+}
+
+static int trie_grow (struct nfa_trie *o, size_t size)
+{
+	unsigned *base, *check, *next, *prev;
+	int *color;
+	size_t i;
+
+	if (size >= UINT_MAX)
+		return 0;
+
+	if ((next = realloc (o->next, size * sizeof (next[0]))) == NULL)
+		return 0;
+
+	o->next = next;
+
+	if ((prev = realloc (o->prev, size * sizeof (prev[0]))) == NULL)
+		return 0;
+
+	o->prev = prev;
+
+	if ((base = realloc (o->base, size * sizeof (base[0]))) == NULL)
+		return 0;
+
+	o->base = base;
+
+	if ((check = realloc (o->check, size * sizeof (check[0]))) == NULL)
+		return 0;
+
+	o->check = check;
+
+	if ((color = realloc (o->color, size * sizeof (color[0]))) == NULL)
+		return 0;
+
+	o->color = color;
+
+	for (i = o->size; i < size; ++i) {
+		base[i]  = TRIE_NONE;
+		check[i] = TRIE_NONE;
+		color[i] = 0;
+
+		next[i] = TRIE_NONE;
+		prev[i] = o->last;
+
+		if (o->last == TRIE_NONE)
+			o->free = i;
+		else
+			next[o->last] = i;
+
+		o->last = i;
+	}
+
+	o->size = size;
+	return 1;
+}
+
+static void trie_take (struct nfa_trie *o, unsigned t)
+{
+	const unsigned next = o->next[t], prev = o->prev[t];
+
+	if (prev == TRIE_NONE)
+		o->free = next;
+	else
+		o->next[prev] = next;
+
+	if (next == TRIE_NONE)
+		o->last = prev;
+	else
+		o->prev[next] = prev;
+}
+
+/*
+ * Returns base such that all children of node fall into free slots: only
+ * bases which put the first child into a free slot are tried
+ */
+static size_t trie_fit (struct nfa_trie *o, unsigned n)
+{
+	const struct trie_node *node = o->node;
+	const unsigned c = node[node[n].child].c;
+	size_t f, base;
+	unsigned t;
+
+	for (f = o->free;; f = o->next[f]) {
+		if (f == TRIE_NONE) {
+			f = o->size;
+
+			if (!trie_grow (o, o->size * 2))
+				return 0;
+		}
+
+		if (f <= c)
+			continue;
+
+		for (base = f - c, t = node[n].child; t != 0; t = node[t].sibling) {
+			if (base + node[t].c >= o->size &&
+			    !trie_grow (o, o->size * 2))
+				return 0;
+
+			if (o->check[base + node[t].c] != TRIE_NONE)
+				break;
+		}
+
+		if (t == 0)
+			return base;
+	}
+}
+
+/*
+ * Place nodes in breadth-first order, the children of a node are placed
+ * when the node is dequeued. A node without children keeps base none,
+ * thus any step from it fails: the root of empty trie is dead, and NUL
+ * byte does not lead back to the root through check[0] == 0.
+ */
+static int trie_compile (struct nfa_trie *o)
+{
+	unsigned *queue, *state, n, t, s;
+	size_t head, tail, base;
+	int ok = 0;
+
+	free (o->base);
+	free (o->check);
+	free (o->color);
+
+	o->base = o->check = NULL;
+	o->color = NULL;
+	o->size = 0;
+	o->free = o->last = TRIE_NONE;
+
+	queue = malloc (o->count * sizeof (queue[0]));
+	state = malloc (o->count * sizeof (state[0]));
+
+	if (queue == NULL || state == NULL ||
+	    !trie_grow (o, o->count + 257))
+		goto error;
+
+	queue[0] = 0, state[0] = 0, o->check[0] = 0;
+	o->color[0] = o->node[0].color;
+	trie_take (o, 0);
+
+	for (head = 0, tail = 1; head < tail; ++head) {
+		n = queue[head];
+		s = state[n];
+
+		if (o->node[n].child == 0)
+			continue;
+
+		if ((base = trie_fit (o, n)) == 0)
+			goto error;
+
+		o->base[s] = base;
+
+		for (t = o->node[n].child; t != 0; t = o->node[t].sibling) {
+			state[t] = base + o->node[t].c;
+			o->check[state[t]] = s;
+			o->color[state[t]] = o->node[t].color;
+			trie_take (o, state[t]);
+			queue[tail++] = t;
+		}
+	}
+
+	o->ready = ok = 1;
+error:
+	free (o->next);
+	free (o->prev);
+	o->next = o->prev = NULL;
+
+	free (state);
+	free (queue);
+	return ok;
+}
+
+int nfa_trie_start (struct nfa_trie *o)
+{
+	if (!o->ready && !trie_compile (o))
+		return -1;
+
+	o->state = 0;
+	return o->color[0];
+}
+
+int nfa_trie_step (struct nfa_trie *o, int c)
+{
+	size_t t;
+
+	if ((unsigned) c > 255)
+		return -1;
+
+	t = (size_t) o->base[o->state] + c;  /* out of range if no children */
+
+	if (t >= o->size || o->check[t] != o->state)
+		return -1;
+
+	o->state = t;
+	return o->color[t];
+}
@@ -0,0 +1,229 @@
+/*
+ * UTF-8 Range Lowering Test
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <peruse/nfa-parse.h>
+#include <peruse/nfa-proc.h>
+
+static const struct utf8_case {
+	int from, to;
+} range[] = {
+	{ 'a',     'z'      },	/* ASCII only */
+	{ 0x80,    0x7ff    },	/* all the two-byte sequences */
+	{ 0x400,   0x44f    },	/* Cyrillic */
+	{ 0x7ff,   0x800    },	/* two to three bytes */
+	{ 0xd7ff,  0xe000   },	/* around surrogates */
+	{ 0xffff,  0x10000  },	/* three to four bytes */
+	{ 0x1f600, 0x1f64f  },	/* emoticons */
+	{ 0x10000, 0x10ffff },	/* all the four-byte sequences */
+	{ 0x61,    0x10ffff },	/* mixed lengths */
+};
+
+/*
+ * Ill-formed sequences: overlongs, surrogates, out of range, stray and
+ * truncated
+ */
+static const char *bad[] = {
+	"\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf",
+	"\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf", "\xed\xa0\x80", "\xed\xbf\xbf",
+	"\xf4\x90\x80\x80", "\xf7\xbf\xbf\xbf", "\xf8\x88\x80\x80\x80", "\xff",
+	"\x80", "\xbf", "\xc3", "\xe2\x82", "\xf0\x9f\x98", "\xd0\xb0\x80",
+};
+
+static int utf8_encode (int c, unsigned char *p)
+{
+	if (c < 0x80) {
+		p[0] = c;
+		return 1;
+	}
+
+	if (c < 0x800) {
+		p[0] = 0xc0 | c >> 6;
+		p[1] = 0x80 | (c & 0x3f);
+		return 2;
+	}
+
+	if (c < 0x10000) {
+		p[0] = 0xe0 | c >> 12;
+		p[1] = 0x80 | (c >> 6 & 0x3f);
+		p[2] = 0x80 | (c & 0x3f);
+		return 3;
+	}
+
+	p[0] = 0xf0 | c >> 18;
+	p[1] = 0x80 | (c >> 12 & 0x3f);
+	p[2] = 0x80 | (c >> 6 & 0x3f);
+	p[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+/*
+ * Strict decoder: returns code point of the well-formed sequence of the
+ * whole length, or -1
+ */
+static int utf8_decode (const unsigned char *p, size_t len)
+{
+	static const int min[] = { 0, 0, 0x80, 0x800, 0x10000 };
+	size_t n, i;
+	int c;
+
+	n = p[0] < 0x80 ? 1 : p[0] < 0xc0 ? 0 : p[0] < 0xe0 ? 2 :
+	    p[0] < 0xf0 ? 3 : p[0] < 0xf8 ? 4 : 0;
+
+	if (n != len)
+		return -1;
+
+	c = n == 1 ? p[0] : p[0] & (0x7f >> n);
+
+	for (i = 1; i < n; ++i) {
+		if ((p[i] & 0xc0) != 0x80)
+			return -1;
+
+		c = c << 6 | (p[i] & 0x3f);
+	}
+
+	if (c < min[n] || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+		return -1;
+
+	return c;
+}
+
+static int match (struct nfa_proc *o, const unsigned char *p, size_t len)
+{
+	int color = nfa_proc_start (o);
+
+	for (; len > 0; ++p, --len)
+		if ((color = nfa_proc_step (o, *p)) < 0)
+			return 0;
+
+	return color > 0;
+}
+
+static struct nfa_proc *compile (const char *re)
+{
+	struct nfa_proc *o;
+
+	if ((o = nfa_proc_alloc (nfa_parse_re (re, 1))) == NULL)
+		fprintf (stderr, "E: cannot compile %s\n", re);
+
+	return o;
+}
+
+/*
+ * Every code point encoding is accepted if and only if the code point is
+ * in range, and ill-formed sequences are rejected
+ */
+static int check_range (const struct utf8_case *r)
+{
+	char re[16];
+	unsigned char seq[4];
+	struct nfa_proc *o;
+	size_t len, i;
+	int c, ok = 1;
+
+	re[0] = '[';
+	len = 1 + utf8_encode (r->from, (void *) (re + 1));
+	re[len++] = '-';
+	len += utf8_encode (r->to, (void *) (re + len));
+	re[len++] = ']';
+	re[len] = '\0';
+
+	if ((o = compile (re)) == NULL)
+		return 0;
+
+	for (c = 0; c <= 0x10ffff && ok; ++c) {
+		if (c == 0xd800)
+			c = 0xe000;
+
+		len = utf8_encode (c, seq);
+
+		if (match (o, seq, len) != (r->from <= c && c <= r->to)) {
+			fprintf (stderr, "E: [%x-%x]: U+%04X\n", r->from,
+				 r->to, c);
+			ok = 0;
+		}
+	}
+
+	for (i = 0; i < sizeof (bad) / sizeof (bad[0]) && ok; ++i)
+		if (match (o, (const void *) bad[i], strlen (bad[i]))) {
+			fprintf (stderr, "E: [%x-%x]: ill-formed sequence %zu "
+				 "accepted\n", r->from, r->to, i);
+			ok = 0;
+		}
+
+	if (ok)
+		printf ("utf8: [U+%04X-U+%04X] ok\n", r->from, r->to);
+
+	nfa_proc_free (o);
+	return ok;
+}
+
+static int check_seq (struct nfa_proc *o, const unsigned char *seq,
+		      size_t len)
+{
+	if (match (o, seq, len) == (utf8_decode (seq, len) >= 0))
+		return 1;
+
+	fprintf (stderr, "E: .: %zu-byte sequence %02x %02x...\n", len,
+		 seq[0], len > 1 ? seq[1] : 0);
+	return 0;
+}
+
+/*
+ * The dot accepts exactly the well-formed sequences: all the sequences of
+ * up to three bytes and four-byte sequences of every lead and second
+ * byte are checked
+ */
+static int check_dot (void)
+{
+	static const unsigned char tail[] = { 0x00, 0x80, 0xbf, 0xc0 };
+	unsigned char seq[4];
+	struct nfa_proc *o;
+	unsigned long x, count = 0;
+	size_t len, j;
+	int ok = 1;
+
+	if ((o = compile (".")) == NULL)
+		return 0;
+
+	for (len = 1; len <= 3; ++len)
+		for (x = 0; x < 1UL << (len * 8) && ok; ++x, ++count) {
+			for (j = 0; j < len; ++j)
+				seq[j] = x >> (8 * (len - 1 - j));
+
+			ok = check_seq (o, seq, len);
+		}
+
+	for (x = 0; x < 1UL << 20 && ok; ++x, ++count) {
+		seq[0] = x >> 12;
+		seq[1] = x >> 4;
+		seq[2] = tail[x >> 2 & 3];
+		seq[3] = tail[x & 3];
+
+		ok = check_seq (o, seq, 4);
+	}
+
+	if (ok)
+		printf ("utf8: . ok, %lu sequences\n", count);
+
+	nfa_proc_free (o);
+	return ok;
+}
+
+int main (int argc, char *argv[])
+{
+	size_t i;
+
+	for (i = 0; i < sizeof (range) / sizeof (range[0]); ++i)
+		if (!check_range (range + i))
+			return 1;
+
+	return check_dot () ? 0 : 1;
+}
@@ -6,12 +6,22 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#define _GNU_SOURCE  /* memfd_create */
+
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <peruse/nfa-window.h>
 
+#include "nfa-perf.h"
+#include "nfa-stats.h"
+
 static size_t stdio_read (void *to, size_t count, void *cookie)
 {
 	return fread (to, 1, count, cookie);
@@ -20,10 +30,95 @@ static size_t stdio_read (void *to, size_t count, void *cookie)
 struct nfa_window {
 	char *data, *cursor;
 	size_t size, avail;
-	nfa_window_reader *read;
+	nfa_window_reader *read;	/* NULL for mapped file */
 	void *cookie;
+	int fd;				/* ring buffer file or -1 */
+
+	size_t reads, read_bytes, moved;	/* statistics */
 };
 
+/*
+ * Ring buffer: the same file is mapped twice into adjacent regions, thus
+ * any size bytes starting in the first region are contiguous in memory,
+ * and neither refill nor release have to move data.
+ */
+static int ring_map (char **data, int fd, size_t size)
+{
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_SHARED | MAP_FIXED;
+	char *p;
+
+	p = mmap (NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return 0;
+
+	if (mmap (p, size, prot, flags, fd, 0) == MAP_FAILED ||
+	    mmap (p + size, size, prot, flags, fd, 0) == MAP_FAILED) {
+		munmap (p, size * 2);
+		return 0;
+	}
+
+	*data = p;
+	return 1;
+}
+
+static int ring_init (struct nfa_window *o)
+{
+	const size_t page = sysconf (_SC_PAGESIZE);
+
+	o->size = (o->size + page - 1) / page * page;
+#ifdef MFD_CLOEXEC
+	if ((o->fd = memfd_create ("nfa-window", MFD_CLOEXEC)) < 0)
+		return 0;
+
+	if (ftruncate (o->fd, o->size) == 0 && ring_map (&o->data, o->fd, o->size))
+		return 1;
+
+	close (o->fd);
+#endif
+	o->fd = -1;
+	return 0;
+}
+
+/*
+ * Double the ring: the file is extended and mapped anew, pages are
+ * shared, thus only the wrapped part of the data (if any) is copied to
+ * follow the rest.
+ */
+static int ring_grow (struct nfa_window *o)
+{
+	const size_t size = o->size * 2, head = o->cursor - o->data;
+	size_t tail = head + o->avail;
+	char *data;
+
+	if (size < o->size || ftruncate (o->fd, size) != 0 ||
+	    !ring_map (&data, o->fd, size))
+		return 0;
+
+	if (tail > o->size)
+		memcpy (data + o->size, data, tail - o->size);
+
+	munmap (o->data, o->size * 2);
+
+	o->data   = data;
+	o->cursor = data + head;
+	o->size   = size;
+	return 1;
+}
+
+static int heap_grow (struct nfa_window *o)
+{
+	const size_t size = o->size * 2;
+	char *data;
+
+	if (size < o->size || (data = realloc (o->data, size)) == NULL)
+		return 0;
+
+	o->data   = o->cursor = data;
+	o->size   = size;
+	return 1;
+}
+
 struct nfa_window *nfa_window_alloc (size_t size, nfa_window_reader *read,
 				     void *cookie)
 {
@@ -34,7 +129,7 @@ struct nfa_window *nfa_window_alloc (size_t size, nfa_window_reader *read,
 
 	o->size = size == 0 ? BUFSIZ : size;
 
-	if ((o->data = malloc (o->size)) == NULL)
+	if (!ring_init (o) && (o->data = malloc (o->size)) == NULL)
 		goto no_data;
 
 	o->cursor = o->data;
@@ -43,37 +138,122 @@ struct nfa_window *nfa_window_alloc (size_t size, nfa_window_reader *read,
 	o->read   = read == NULL ? stdio_read : read;
 	o->cookie = cookie;
 
+	o->reads  = o->read_bytes = o->moved = 0;
+
 	return o;
 no_data:
 	free (o);
 	return NULL;
 }
 
+struct nfa_window *nfa_window_alloc_mmap (int fd)
+{
+	struct nfa_window *o;
+	struct stat st;
+
+	if (fstat (fd, &st) != 0)
+		return NULL;
+
+	if (!S_ISREG (st.st_mode)) {
+		errno = EINVAL;  /* pipes, terminals and sockets have no size */
+		return NULL;
+	}
+
+	if ((o = malloc (sizeof (*o))) == NULL)
+		return NULL;
+
+	o->data = NULL;
+	o->size = st.st_size;
+
+	if (o->size > 0 &&
+	    (o->data = mmap (NULL, o->size, PROT_READ, MAP_PRIVATE, fd, 0))
+	    == MAP_FAILED)
+		goto no_map;
+#ifdef MADV_SEQUENTIAL
+	if (o->size > 0)
+		madvise (o->data, o->size, MADV_SEQUENTIAL);
+#endif
+	o->cursor = o->data;
+	o->avail  = o->size;
+
+	o->read   = NULL;
+	o->cookie = NULL;
+	o->fd     = -1;
+
+	o->reads  = o->read_bytes = o->moved = 0;
+
+	return o;
+no_map:
+	free (o);
+	return NULL;
+}
+
 void nfa_window_free (struct nfa_window *o)
 {
 	if (o == NULL)
 		return;
 
-	free (o->data);
+	if (o->read == NULL) {
+		if (o->size > 0)
+			munmap (o->data, o->size);
+	}
+	else if (o->fd >= 0) {
+		munmap (o->data, o->size * 2);
+		close (o->fd);
+	}
+	else
+		free (o->data);
+
 	free (o);
 }
 
-int nfa_window_fill (struct nfa_window *o)
+static int window_fill (struct nfa_window *o)
 {
+	char *tail;
 	size_t count;
 
-	/*
-	 * move existing data into head of buffer
-	 */
-	memmove (o->data, o->cursor, o->avail);
-	o->cursor = o->data;
+	if (o->read == NULL)
+		return 0;  /* whole file is in window already */
+
+	if (o->avail == o->size &&
+	    !(o->fd >= 0 ? ring_grow (o) : heap_grow (o)))
+		return 0;
+
+	if (o->fd >= 0) {
+		tail = o->cursor + o->avail;
 
-	count = o->read (o->cursor + o->avail, o->size - o->avail, o->cookie);
+		if (tail >= o->data + o->size)
+			tail -= o->size;
+	}
+	else {
+		/*
+		 * move existing data into head of buffer
+		 */
+		memmove (o->data, o->cursor, o->avail);
+		nfa_stats_add (o->moved, o->avail);
+		o->cursor = o->data;
+		tail = o->cursor + o->avail;
+	}
+
+	count = o->read (tail, o->size - o->avail, o->cookie);
 	o->avail += count;
 
+	nfa_stats_inc (o->reads);
+	nfa_stats_add (o->read_bytes, count);
+
 	return count > 0;
 }
 
+int nfa_window_fill (struct nfa_window *o)
+{
+	int ok;
+
+	nfa_perf_enter (NFA_PERF_FILL);
+	ok = window_fill (o);
+	nfa_perf_leave (NFA_PERF_FILL);
+	return ok;
+}
+
 void *nfa_window_request (struct nfa_window *o, size_t *len)
 {
 	if (*len > o->avail)
@@ -89,4 +269,17 @@ void nfa_window_release (struct nfa_window *o, size_t len)
 
 	o->avail  -= len;
 	o->cursor += len;
+
+	if (o->fd >= 0 && o->cursor >= o->data + o->size)
+		o->cursor -= o->size;
+}
+
+int nfa_window_stats (const struct nfa_window *o, struct nfa_window_stats *s)
+{
+	s->size  = o->size;
+	s->reads = o->reads;
+	s->read  = o->read_bytes;
+	s->moved = o->moved;
+
+	return NFA_STATS;
 }
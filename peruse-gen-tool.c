@@ -0,0 +1,524 @@
+/*
+ * Direct-coded DFA Scanner Generator
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <peruse/nfa-dfa.h>
+#include <peruse/nfa-parse.h>
+
+/*
+ * Rule file: one rule per line, color (positive number) followed by
+ * regular expression up to the end of line. Escapes \t, \n and \r stand
+ * for tab, line feed and carriage return, other escapes are passed to RE
+ * compiler as is. Empty lines and lines started with # are ignored.
+ */
+static void rule_unescape (char *s)
+{
+	char *p;
+
+	for (p = s; *s != '\0'; ++s) {
+		if (*s == '\\' && s[1] != '\0') {
+			switch (*++s) {
+			case 't':	*p++ = '\t'; continue;
+			case 'n':	*p++ = '\n'; continue;
+			case 'r':	*p++ = '\r'; continue;
+			}
+
+			*p++ = '\\';
+		}
+
+		*p++ = *s;
+	}
+
+	*p = '\0';
+}
+
+static void rules_free (struct nfa_rule *o)
+{
+	struct nfa_rule *next;
+
+	for (; o != NULL; o = next) {
+		next = o->next;
+		free (o->re);
+		free (o);
+	}
+}
+
+static struct nfa_rule *rules_read (FILE *f, const char *name)
+{
+	struct nfa_rule *head = NULL, **tail = &head, *r;
+	char *line = NULL, *p, *end;
+	size_t size = 0, n;
+	long color;
+
+	for (n = 1; getline (&line, &size, f) >= 0; ++n) {
+		line[strcspn (line, "\r\n")] = '\0';
+
+		for (p = line; isspace ((unsigned char) *p); ++p) {}
+
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		color = strtol (p, &end, 10);
+
+		if (end == p || color <= 0 || color > 0x7fffffff ||
+		    !isspace ((unsigned char) *end)) {
+			fprintf (stderr, "%s:%zu: E: rule color expected\n",
+				 name, n);
+			goto error;
+		}
+
+		for (p = end; isspace ((unsigned char) *p); ++p) {}
+
+		if ((r = malloc (sizeof (*r))) == NULL)
+			goto no_mem;
+
+		if ((r->re = strdup (p)) == NULL) {
+			free (r);
+			goto no_mem;
+		}
+
+		rule_unescape (r->re);
+		r->next  = NULL;
+		r->color = color;
+
+		*tail = r;
+		tail = &r->next;
+	}
+
+	if (head == NULL)
+		fprintf (stderr, "%s: E: no rules defined\n", name);
+
+	free (line);
+	return head;
+no_mem:
+	perror ("peruse-gen");
+error:
+	free (line);
+	rules_free (head);
+	return NULL;
+}
+
+/*
+ * Scanner emitter: every DFA state becomes a label followed by switch
+ * over the next byte. The state reached is stored on window refill only,
+ * thus the generated lexer is resumed at the same state after refill.
+ */
+struct gen {
+	FILE *out;
+	const char *prefix;
+	const struct nfa_dfa *dfa;
+	size_t count;
+	char *ref;		/* entry labels of states used */
+};
+
+/*
+ * The header is expected to be placed next to the source, thus it is
+ * included by its base name
+ */
+static void emit_head (struct gen *o, const char *rules, const char *header)
+{
+	const char *name;
+
+	fprintf (o->out,
+		"/*\n"
+		" * Direct-coded DFA Scanner\n"
+		" *\n"
+		" * Generated by peruse-gen from %s, do not edit.\n"
+		" */\n"
+		"\n"
+		"#include <stdint.h>\n"
+		"#include <stdlib.h>\n"
+		"\n"
+		"#include <peruse/nfa-lexer.h>\n"
+		"#include <peruse/nfa-window.h>\n"
+		"\n", rules);
+
+	if (header != NULL) {
+		name = strrchr (header, '/');
+		fprintf (o->out, "#include \"%s\"\n\n",
+			 name == NULL ? header : name + 1);
+	}
+
+	fprintf (o->out,
+		"struct %1$s {\n"
+		"\tstruct nfa_window *in;\n"
+		"\tstruct nfa_token token;\n"
+		"\tint eof;\n"
+		"};\n"
+		"\n"
+		"static struct %1$s *%1$s_init (struct nfa_window *in, int eof)\n"
+		"{\n"
+		"\tstruct %1$s *o;\n"
+		"\n"
+		"\tif (in == NULL)\n"
+		"\t\treturn NULL;\n"
+		"\n"
+		"\tif ((o = malloc (sizeof (*o))) == NULL) {\n"
+		"\t\tnfa_window_free (in);\n"
+		"\t\treturn NULL;\n"
+		"\t}\n"
+		"\n"
+		"\to->in = in;\n"
+		"\to->token.color = 0;\n"
+		"\to->token.text = NULL;\n"
+		"\to->token.len = 0;\n"
+		"\to->eof = eof;\n"
+		"\treturn o;\n"
+		"}\n"
+		"\n"
+		"struct %1$s *%1$s_alloc (size_t size, peruse_reader *read, "
+		"void *cookie)\n"
+		"{\n"
+		"\treturn %1$s_init (nfa_window_alloc (size, read, cookie), 0);\n"
+		"}\n"
+		"\n"
+		"struct %1$s *%1$s_alloc_mmap (int fd)\n"
+		"{\n"
+		"\treturn %1$s_init (nfa_window_alloc_mmap (fd), 1);\n"
+		"}\n"
+		"\n"
+		"void %1$s_free (struct %1$s *o)\n"
+		"{\n"
+		"\tif (o == NULL)\n"
+		"\t\treturn;\n"
+		"\n"
+		"\tnfa_window_free (o->in);\n"
+		"\tfree (o);\n"
+		"}\n"
+		"\n"
+		"int %1$s_eof (struct %1$s *o)\n"
+		"{\n"
+		"\tsize_t avail = 1;\n"
+		"\n"
+		"\tnfa_window_request (o->in, &avail);\n"
+		"\n"
+		"\treturn o->eof && avail == 0;\n"
+		"}\n"
+		"\n"
+		"const struct nfa_token *%1$s_get (struct %1$s *o)\n"
+		"{\n"
+		"\treturn o->token.color == 0 ? NULL : &o->token;\n"
+		"}\n"
+		"\n", o->prefix);
+}
+
+/*
+ * Returns the most frequent target of the state to use it as the switch
+ * default. Only hits of targets of the state are touched.
+ */
+static size_t gen_default (struct gen *o, size_t s, size_t *hits)
+{
+	size_t c, t, best = nfa_dfa_move (o->dfa, s, 0);
+
+	for (c = 0; c < 256; ++c)
+		hits[nfa_dfa_move (o->dfa, s, c)] = 0;
+
+	for (c = 0; c < 256; ++c) {
+		t = nfa_dfa_move (o->dfa, s, c);
+
+		if (++hits[t] > hits[best])
+			best = t;
+	}
+
+	return best;
+}
+
+/*
+ * Returns 1 if no one byte moves from the state to a live state, thus
+ * the token ends there without look at the next byte
+ */
+static int gen_final (struct gen *o, size_t s)
+{
+	size_t c;
+
+	for (c = 0; c < 256; ++c)
+		if (nfa_dfa_move (o->dfa, s, c) != 0)
+			return 0;
+
+	return 1;
+}
+
+static void emit_goto (struct gen *o, size_t t)
+{
+	if (t == 0)
+		fprintf (o->out, "\t\t\tgoto done;\n");
+	else
+		fprintf (o->out, "\t\t\tgoto s%zu;\n", t);
+}
+
+static void emit_case (struct gen *o, size_t s, size_t t)
+{
+	size_t c, n;
+
+	for (n = 0, c = 0; c < 256; ++c) {
+		if (nfa_dfa_move (o->dfa, s, c) != t)
+			continue;
+
+		fprintf (o->out, n == 0     ? "\t\tcase 0x%02zx:" :
+				 n % 6 == 0 ? "\n\t\tcase 0x%02zx:" :
+					      " case 0x%02zx:", c);
+		++n;
+	}
+
+	fprintf (o->out, "\n");
+	emit_goto (o, t);
+}
+
+static void emit_state (struct gen *o, size_t s, size_t *hits)
+{
+	const int color = nfa_dfa_color (o->dfa, s);
+	size_t def, c, t;
+
+	if (o->ref[s])
+		fprintf (o->out, "\ts%zu:\n", s);
+
+	if (color > 0)
+		fprintf (o->out, "\t\tcolor = %d, len = i;\n", color);
+
+	if (gen_final (o, s)) {
+		fprintf (o->out, "\t\tgoto done;\n");
+		return;
+	}
+
+	fprintf (o->out,
+		"\tr%zu:\n"
+		"\t\tif (i == avail) {\n"
+		"\t\t\tstate = %zu;\n"
+		"\t\t\tgoto fill;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\tswitch (cursor[i++]) {\n", s, s);
+
+	def = gen_default (o, s, hits);
+
+	for (c = 0; c < 256; ++c) {
+		t = nfa_dfa_move (o->dfa, s, c);
+
+		if (t != def && hits[t] != 0) {
+			emit_case (o, s, t);
+			hits[t] = 0;  /* emitted */
+		}
+	}
+
+	fprintf (o->out, "\t\tdefault:\n");
+	emit_goto (o, def);
+	fprintf (o->out, "\t\t}\n");
+}
+
+static int emit_lexer (struct gen *o)
+{
+	size_t *hits, s, c;
+
+	if ((hits = malloc (o->count * sizeof (hits[0]))) == NULL)
+		return 0;
+
+	for (s = 1; s < o->count; ++s)
+		for (c = 0; c < 256; ++c)
+			o->ref[nfa_dfa_move (o->dfa, s, c)] = 1;
+
+	fprintf (o->out,
+		"/*\n"
+		" * The token text stays valid until the next call to lexer\n"
+		" */\n"
+		"const struct nfa_token *%1$s (struct %1$s *o)\n"
+		"{\n"
+		"\tconst unsigned char *cursor;\n"
+		"\tsize_t i = 0, avail, len = 0, state = 1;\n"
+		"\tint color = %2$d;\n"
+		"\n"
+		"\tnfa_window_release (o->in, o->token.len);\n"
+		"\n"
+		"\tfor (;;) {\n"
+		"\t\tavail = SIZE_MAX;\n"
+		"\t\tcursor = nfa_window_request (o->in, &avail);\n"
+		"\n"
+		"\t\tswitch (state) {\n",
+		o->prefix, nfa_dfa_color (o->dfa, 1));
+
+	for (s = 1; s < o->count; ++s)
+		if (!gen_final (o, s))
+			fprintf (o->out, "\t\tcase %zu: goto r%zu;\n", s, s);
+
+	fprintf (o->out, "\t\t}\n");
+
+	for (s = 1; s < o->count; ++s) {
+		fprintf (o->out, "\n");
+		emit_state (o, s, hits);
+	}
+
+	fprintf (o->out,
+		"\n"
+		"\tfill:\n"
+		"\t\tif (o->eof)\n"
+		"\t\t\tgoto done;\n"
+		"\n"
+		"\t\tif (!nfa_window_fill (o->in))\n"
+		"\t\t\to->eof = 1;\n"
+		"\t}\n"
+		"done:\n"
+		"\to->token.color = color;\n"
+		"\to->token.text = (void *) cursor;\n"
+		"\to->token.len = len;\n"
+		"\n"
+		"\treturn %s_get (o);\n"
+		"}\n", o->prefix);
+
+	free (hits);
+	return 1;
+}
+
+static void emit_guard (FILE *out, const char *prefix, const char *tail)
+{
+	fprintf (out, "PERUSE_GEN_");
+
+	for (; *prefix != '\0'; ++prefix)
+		fputc (toupper ((unsigned char) *prefix), out);
+
+	fprintf (out, "_H%s", tail);
+}
+
+static void emit_header (FILE *out, const char *prefix)
+{
+	fprintf (out,
+		"/*\n"
+		" * Direct-coded DFA Scanner\n"
+		" *\n"
+		" * Generated by peruse-gen, do not edit.\n"
+		" */\n"
+		"\n"
+		"#ifndef ");
+	emit_guard (out, prefix, "\n#define ");
+	emit_guard (out, prefix, "  1\n\n");
+
+	fprintf (out,
+		"#include <peruse/nfa-lexer.h>\n"
+		"\n"
+		"/*\n"
+		" * The scanner context has the same interface as nfa_lexer has\n"
+		" */\n"
+		"struct %1$s *%1$s_alloc (size_t size, peruse_reader *read, "
+		"void *cookie);\n"
+		"struct %1$s *%1$s_alloc_mmap (int fd);\n"
+		"void %1$s_free (struct %1$s *o);\n"
+		"\n"
+		"int %1$s_eof (struct %1$s *o);\n"
+		"\n"
+		"const struct nfa_token *%1$s_get (struct %1$s *o);\n"
+		"const struct nfa_token *%1$s     (struct %1$s *o);\n"
+		"\n"
+		"#endif  /* ", prefix);
+	emit_guard (out, prefix, " */\n");
+}
+
+static int usage (void)
+{
+	fprintf (stderr, "usage:\n\tperuse-gen [-p prefix] [-o source] "
+			 "[-H header] rules\n");
+	return 1;
+}
+
+static int valid_prefix (const char *s)
+{
+	if (!isalpha ((unsigned char) *s) && *s != '_')
+		return 0;
+
+	for (; *s != '\0'; ++s)
+		if (!isalnum ((unsigned char) *s) && *s != '_')
+			return 0;
+
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *source = NULL, *header = NULL;
+	struct nfa_rule *rules;
+	struct nfa_state *nfa;
+	struct nfa_dfa *dfa;
+	struct gen o;
+	FILE *in, *h;
+	int opt, ok;
+
+	o.prefix = "scanner";
+
+	while ((opt = getopt (argc, argv, "p:o:H:")) != -1)
+		switch (opt) {
+		case 'p':	o.prefix = optarg; break;
+		case 'o':	source   = optarg; break;
+		case 'H':	header   = optarg; break;
+		default:	return usage ();
+		}
+
+	if (optind + 1 != argc || !valid_prefix (o.prefix))
+		return usage ();
+
+	if ((in = fopen (argv[optind], "r")) == NULL) {
+		perror (argv[optind]);
+		return 1;
+	}
+
+	rules = rules_read (in, argv[optind]);
+	fclose (in);
+
+	if (rules == NULL)
+		return 1;
+
+	if ((nfa = nfa_parse_rules (rules)) == NULL) {
+		fprintf (stderr, "%s: E: cannot compile rules\n", argv[optind]);
+		goto no_dfa;
+	}
+
+	if ((dfa = nfa_dfa_alloc (nfa)) == NULL) {
+		fprintf (stderr, "%s: E: cannot compile NFA to DFA\n",
+			 argv[optind]);
+		goto no_dfa;
+	}
+
+	if (header != NULL) {
+		if ((h = fopen (header, "w")) == NULL)
+			goto no_output;
+
+		emit_header (h, o.prefix);
+
+		if (fclose (h) != 0)
+			goto no_output;
+	}
+
+	o.out = source == NULL ? stdout : fopen (source, "w");
+
+	if (o.out == NULL)
+		goto no_output;
+
+	o.dfa   = dfa;
+	o.count = nfa_dfa_count (dfa);
+
+	if ((o.ref = calloc (o.count, sizeof (o.ref[0]))) == NULL)
+		goto no_output;
+
+	emit_head (&o, argv[optind], header);
+	ok = emit_lexer (&o);
+	free (o.ref);
+
+	if (!ok || (o.out == stdout ? fflush (o.out) : fclose (o.out)) != 0)
+		goto no_output;
+
+	nfa_dfa_free (dfa);
+	rules_free (rules);
+	return 0;
+no_output:
+	perror ("peruse-gen");
+	nfa_dfa_free (dfa);
+no_dfa:
+	rules_free (rules);
+	return 1;
+}
@@ -1,7 +1,7 @@
 /*
  * RE simple lexer
  *
- * Copyright (c) 2020-2021 Alexei A. Smekalkine <ikle@ikle.ru>
+ * Copyright (c) 2020-2024 Alexei A. Smekalkine <ikle@ikle.ru>
  *
  * SPDX-License-Identifier: BSD-2-Clause
  */
@@ -20,9 +20,42 @@ static void re_lexer_init (struct re_lexer *o, const char *re)
 
 static int re_lexer_peek (struct re_lexer *o)
 {
-	return *o->p;
+	return (unsigned char) *o->p;
 }
 
+/*
+ * Decodes UTF-8 sequence started with the lead byte c. Returns code
+ * point, or -1 on ill-formed sequence (overlong forms and surrogates
+ * included).
+ */
+static int re_lexer_utf8 (struct re_lexer *o, int c)
+{
+	static const int min[] = { 0x80, 0x800, 0x10000 };
+	const unsigned char *p = (const void *) o->p;
+	int n, i;
+
+	n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+
+	if (n == 0 || c > 0xf4)
+		return -1;
+
+	for (c &= 0x3f >> n, i = 1; i <= n; ++i) {
+		if ((p[i] & 0xc0) != 0x80)
+			return -1;
+
+		c = (c << 6) | (p[i] & 0x3f);
+	}
+
+	if (c < min[n - 1] || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+		return -1;
+
+	o->p += n;
+	return c;
+}
+
+/*
+ * Returns the next code point, or -1 on ill-formed UTF-8
+ */
 static int re_lexer_next (struct re_lexer *o)
 {
 	int c;
@@ -30,6 +63,9 @@ static int re_lexer_next (struct re_lexer *o)
 	if ((c = re_lexer_peek (o)) == '\0')
 		return c;
 
+	if (c >= 0x80)
+		c = re_lexer_utf8 (o, c);
+
 	++o->p;
 	return c;
 }
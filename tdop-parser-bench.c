@@ -0,0 +1,76 @@
+/*
+ * Sample Top-Down Operator Precedence parser Benchmark
+ *
+ * Copyright (c) 2024 Alexei A. Smekalkine <ikle@ikle.ru>
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#define main	tdop_parser_sample
+#include "tdop-parser-test.c"
+#undef main
+
+#include "bench.h"
+
+#define CORPUS_SIZE	(4 << 20)
+
+/*
+ * Parses every program of the corpus from memory stream, tokens of the
+ * sample grammar are single characters
+ */
+static int run (struct bench *o, const void *arg)
+{
+	const size_t *count = arg;
+	struct se_node *tree;
+	char *data, *p;
+	size_t len, i;
+	FILE *in;
+	double start;
+
+	if ((data = bench_eqn (CORPUS_SIZE, *count)) == NULL)
+		return 0;
+
+	for (p = data; (len = strlen (p)) > 0; p += len + 1) {
+		for (i = 0; i < len; ++i)
+			o->tokens += !isspace ((unsigned char) p[i]);
+
+		if ((in = fmemopen (p, len, "r")) == NULL)
+			goto error;
+
+		start = bench_now ();
+
+		if ((tree = parse (in)) != NULL)
+			se_node_free (tree);
+
+		o->time  += bench_now () - start;
+		o->bytes += len;
+		fclose (in);
+
+		if (tree == NULL) {
+			fprintf (stderr, "E: %s at (%d,%d)\n", error, x, y);
+			goto error;
+		}
+	}
+
+	free (data);
+	return 1;
+error:
+	free (data);
+	return 0;
+}
+
+int main (int argc, char *argv[])
+{
+	static const size_t count[] = { 1, 16, 256 };
+	char test[32];
+	size_t i;
+
+	for (i = 0; i < sizeof (count) / sizeof (count[0]); ++i) {
+		snprintf (test, sizeof (test), "eqn-%zu", count[i]);
+
+		if (!bench_run ("tdop-parser", test, run, count + i))
+			return 1;
+	}
+
+	return 0;
+}